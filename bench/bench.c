@@ -0,0 +1,290 @@
+/*******************************************************************************
+ * bench.c
+ * Times every phase of a run on generated cohorts of growing size, so each
+ * release can be compared against the last one
+ *
+ * Steps to run:
+ * make bench
+ * ./benchmark [sizes...]
+*******************************************************************************/
+
+/*******************************************************************************
+ * Standard & Custom header files
+*******************************************************************************/
+
+#include "../global/global.h"          /* standard libraries, consts, structs */
+
+#include <sys/resource.h>               /* getrusage */
+
+#include "../student/student.h"         /* generate_students sanity_check_students load_students_from_csv build_roster free_roster */
+#include "../group/group.h"             /* create_initial_groups csv_groups free_groups */
+#include "../solver/solver.h"           /* solve default_solver_config */
+#include "../writer/writer.h"           /* save_students_bin load_students_bin */
+#include "../rng/rng.h"                 /* rng_seed */
+#include "../utils/utils.h"             /* time_ms */
+
+/*******************************************************************************
+ * Global variables
+*******************************************************************************/
+
+extern int DEBUG;
+
+/*
+    Constants
+*/
+#define BENCH_GROUP_SIZE    5                       /* Group size every cohort is solved with */
+#define BENCH_SOLVE_MS      2000                    /* Time limit of the solve phase */
+#define BENCH_SEED          1                       /* Seed of the cohorts and the solver */
+#define BENCH_PASSWORD      "benchmark"             /* Password of the binary save */
+#define BENCH_STUDENTS_CSV  "bench_students.csv"    /* Scratch files, removed afterwards */
+#define BENCH_GROUPS_CSV    "bench_groups.csv"
+#define BENCH_STUDENTS_BIN  "bench_students.bin"
+
+/*******************************************************************************
+ * Function prototypes
+*******************************************************************************/
+
+int main(int argc, char* argv[]);
+
+/**
+ * Peak resident memory of the process so far
+ * Return: long, kilobytes
+ *
+ * Outputs
+ *  - Peak resident set size
+ *
+ */
+long peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_maxrss;
+}
+
+/**
+ * Writes students to a csv in the same layout load_students_from_csv() reads
+ * Return: int, 0 for fail, 1 for success
+ *
+ * Inputs
+ *  - students      the array of students
+ *  - num_students  the number of students
+ *  - filename      file to write to
+ * Outputs
+ *  - Csv of student preferences
+ *
+ */
+int write_students_csv(Student* students, int num_students, char filename[]) {
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        return 0;
+    }
+
+    for (int i = 0; i < num_students; i++) {
+        fprintf(file, "%d", students[i].student_id);
+        for (int j = 0; j < MAX_STUDENT_PREFERENCES; j++) {
+            fprintf(file, ", %d", students[i].preferences[j]);
+        }
+        fprintf(file, "\n");
+    }
+
+    return fclose(file) == 0;
+}
+
+/**
+ * Prints the time and throughput of a phase
+ * Return: void
+ *
+ * Inputs
+ *  - name          name of the phase
+ *  - elapsed       milliseconds the phase took
+ *  - count         number of things the phase worked through
+ *  - unit          what count is counting
+ * Outputs
+ *  - One row of the results table
+ *
+ */
+void print_phase(char* name, double elapsed, double count, char* unit) {
+    double rate = (elapsed > 0) ? count * 1000.0 / elapsed : 0;
+    printf("  %-24s %10.1f ms %14.0f %s/s\n", name, elapsed, rate, unit);
+}
+
+/**
+ * Orders cohort sizes from smallest to largest
+ * Return: int, qsort comparison
+ *
+ * Inputs
+ *   a          Pointer to the first size
+ *   b          Pointer to the second size
+ * Outputs
+ *  - Negative if a comes first
+ *
+ */
+int cmp_cohort_size(const void* a, const void* b) {
+    int size_a = *(int*)a;
+    int size_b = *(int*)b;
+    return (size_a > size_b) - (size_a < size_b);
+}
+
+/**
+ * Runs every phase on a generated cohort
+ * Return: int, 0 for fail, 1 for success
+ *
+ * Inputs
+ *  - num_students  size of the cohort
+ * Outputs
+ *  - Results table of the cohort
+ *
+ */
+int bench_cohort(int num_students) {
+    printf("\n%d students\n", num_students);
+
+    Rng rng;
+    rng_seed(&rng, BENCH_SEED);
+    Student* generated = generate_students(num_students, &rng);
+    if (generated == NULL || !write_students_csv(generated, num_students, BENCH_STUDENTS_CSV)) {
+        free(generated);
+        printf("  Could not generate students\n");
+        return 0;
+    }
+    free(generated);
+
+    /* Csv load */
+    Student* students = (Student*)malloc(sizeof(Student) * 0);
+    int loaded = 0;
+    double start = time_ms();
+    int load_result = load_students_from_csv(BENCH_STUDENTS_CSV, &students, &loaded);
+    print_phase("load_students_from_csv", time_ms() - start, loaded, "students");
+    remove(BENCH_STUDENTS_CSV);
+
+    if (load_result == 1 || loaded != num_students) {
+        free(students);
+        printf("  Could not load students\n");
+        return 0;
+    }
+
+    start = time_ms();
+    int sane = sanity_check_students(students, num_students);
+    print_phase("sanity_check_students", time_ms() - start, num_students, "students");
+    if (!sane) {
+        printf("  Generated students failed the sanity check\n");
+    }
+
+    start = time_ms();
+    Roster* roster = build_roster(students, num_students);
+    print_phase("build_roster", time_ms() - start, num_students, "students");
+    if (roster == NULL) {
+        free(students);
+        printf("  Could not index students\n");
+        return 0;
+    }
+
+    start = time_ms();
+    Groups* groups = create_initial_groups(roster, BENCH_GROUP_SIZE);
+    print_phase("create_initial_groups", time_ms() - start, num_students, "students");
+    if (groups == NULL) {
+        free_roster(roster);
+        free(students);
+        printf("  Could not create groups\n");
+        return 0;
+    }
+
+    /* Solve for a fixed time */
+    SolverConfig config;
+    default_solver_config(&config);
+    config.time_limit = BENCH_SOLVE_MS;
+    config.seed = BENCH_SEED;
+
+    SolverReport report;
+    int solved = solve(roster, groups, &config, &report);
+    if (solved) {
+        print_phase("solve search", report.elapsed - report.refine_elapsed, report.iterations, "iterations");
+        print_phase("solve refine", report.refine_elapsed, num_students, "students");
+        printf("  %-24s %10.6f\n", "average happiness", average_happiness(groups));
+    } else {
+        printf("  Could not solve\n");
+    }
+
+    start = time_ms();
+    int written = csv_groups(groups, roster, BENCH_GROUPS_CSV);
+    print_phase("csv_groups", time_ms() - start, num_students, "students");
+    remove(BENCH_GROUPS_CSV);
+    if (!written) {
+        printf("  Could not write groups\n");
+    }
+
+    free_groups(groups);
+    free_roster(roster);
+
+    /* Binary save and load, compressed and encrypted */
+    start = time_ms();
+    int saved = save_students_bin(students, num_students, BENCH_PASSWORD, BENCH_STUDENTS_BIN);
+    print_phase("save_students_bin", time_ms() - start, num_students, "students");
+    free(students);
+
+    if (saved != 0) {
+        remove(BENCH_STUDENTS_BIN);
+        printf("  Could not save students\n");
+        return 0;
+    }
+
+    Student* reloaded = NULL;
+    int reloaded_size = 0;
+    start = time_ms();
+    int reload_result = load_students_bin(&reloaded, &reloaded_size, BENCH_PASSWORD, BENCH_STUDENTS_BIN);
+    print_phase("load_students_bin", time_ms() - start, reloaded_size, "students");
+    remove(BENCH_STUDENTS_BIN);
+    free(reloaded);
+
+    if (reload_result != 0 || reloaded_size != num_students) {
+        printf("  Could not load students back\n");
+    }
+
+    /* Cohorts are run smallest first, so the peak so far is the peak of this cohort */
+    printf("  %-24s %10ld KB\n", "peak rss", peak_rss_kb());
+    return 1;
+}
+
+/**
+ * Entry of the benchmark, runs each cohort size in turn from smallest to
+ * largest, as the peak resident memory only ever grows
+ * Return: int, 0 for success, 1 for failed
+ *
+ * Inputs
+ *  - argc     Number of arguments
+ *  - argv     Cohort sizes, 1000 10000 100000 1000000 if none are given
+ * Outputs
+ *  - Results table of every cohort
+ *
+ */
+int main(int argc, char* argv[]) {
+    int default_sizes[4] = {1000, 10000, 100000, 1000000};
+    int failed = 0;
+
+    if (argc < 2) {
+        for (int i = 0; i < 4; i++) {
+            failed |= !bench_cohort(default_sizes[i]);
+        }
+        return failed;
+    }
+
+    int* sizes = (int*)malloc(sizeof(int) * (argc - 1));
+    if (sizes == NULL) {
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        sizes[i - 1] = atoi(argv[i]);
+        if (sizes[i - 1] < BENCH_GROUP_SIZE * 2) {
+            printf("Invalid cohort size %s, must be at least %d\n", argv[i], BENCH_GROUP_SIZE * 2);
+            free(sizes);
+            return 1;
+        }
+    }
+    qsort(sizes, argc - 1, sizeof(int), cmp_cohort_size);
+
+    for (int i = 0; i < argc - 1; i++) {
+        failed |= !bench_cohort(sizes[i]);
+    }
+    free(sizes);
+    return failed;
+}
@@ -0,0 +1,297 @@
+/*******************************************************************************
+ * checkpoint.c
+ * Saves and loads the state of a solver run, so it can be continued later
+*******************************************************************************/
+
+/*******************************************************************************
+ * Function prototypes
+*******************************************************************************/
+
+#include "checkpoint.h"
+
+#include <unistd.h>         /* fsync */
+
+#include "../group/group.h" /* allocate_groups free_groups */
+
+/*******************************************************************************
+ * Global variables
+*******************************************************************************/
+
+extern int DEBUG;
+
+/*
+    Constants
+*/
+#define CHECKPOINT_MAGIC    "UUCK"  /* First bytes of every checkpoint file */
+#define CHECKPOINT_VERSION  2       /* Bumped whenever the layout below changes */
+
+/**
+ * Mixes some bytes into an FNV-1a hash
+ * Return: unsigned long long, the updated hash
+ *
+ * Inputs
+ *  - hash          Hash so far
+ *  - data          Bytes to mix in
+ *  - size          Number of bytes
+ * Outputs
+ *  - Updated hash
+ *
+ */
+unsigned long long fnv1a(unsigned long long hash, void* data, size_t size) {
+    unsigned char* bytes = (unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * Hashes the students and the group layout, so a checkpoint is only ever
+ * resumed against the input it was made from
+ * Return: unsigned long long
+ *
+ * Inputs
+ *  - roster        Dense students
+ *  - groups        Groups being solved
+ * Outputs
+ *  - Fingerprint
+ *
+ */
+unsigned long long roster_fingerprint(Roster* roster, Groups* groups) {
+    int num_students = roster->num_students;
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+
+    hash = fnv1a(hash, &num_students, sizeof(int));
+    hash = fnv1a(hash, &groups->number_of_groups, sizeof(int));
+    hash = fnv1a(hash, &groups->max_group_size, sizeof(int));
+    hash = fnv1a(hash, roster->student_ids, sizeof(int) * num_students);
+    hash = fnv1a(hash, roster->preferences, sizeof(int) * num_students * MAX_STUDENT_PREFERENCES);
+    hash = fnv1a(hash, roster->preferences_size, sizeof(int) * num_students);
+
+    /* Constraints change which groupings are allowed */
+    if (roster->together != NULL) {
+        hash = fnv1a(hash, roster->together, sizeof(int) * num_students);
+        hash = fnv1a(hash, roster->apart_start, sizeof(int) * (num_students + 1));
+        hash = fnv1a(hash, roster->apart, sizeof(int) * roster->apart_start[num_students]);
+    }
+    return hash;
+}
+
+/**
+ * Writes groups to an open checkpoint file
+ * Return: int, 0 for fail, 1 for success
+ *
+ * Inputs
+ *  - groups        The groups to write
+ *  - file          File to write to
+ * Outputs
+ *  - Groups in the file
+ *
+ */
+int write_groups(Groups* groups, FILE* file) {
+    int number_of_groups = groups->number_of_groups;
+    size_t slots = (size_t)number_of_groups * groups->max_group_size;
+
+    return fwrite(&groups->number_of_groups, sizeof(int), 1, file) == 1
+        && fwrite(&groups->max_group_size, sizeof(int), 1, file) == 1
+        && fwrite(&groups->num_students, sizeof(int), 1, file) == 1
+        && fwrite(groups->members, sizeof(int), slots, file) == slots
+        && fwrite(groups->group_size, sizeof(int), number_of_groups, file) == (size_t)number_of_groups
+        && fwrite(groups->points, sizeof(int), number_of_groups, file) == (size_t)number_of_groups
+        && fwrite(groups->happiness, sizeof(float), number_of_groups, file) == (size_t)number_of_groups
+        && fwrite(groups->group_of, sizeof(int), groups->num_students, file) == (size_t)groups->num_students;
+}
+
+/**
+ * Reads groups from an open checkpoint file
+ * Return: groups pointer, NULL if the file was cut short or allocation failed
+ *
+ * Inputs
+ *  - file          File to read from
+ * Outputs
+ *  - Newly allocated groups, free with free_groups()
+ *
+ */
+Groups* read_groups(FILE* file) {
+    int shape[3];
+    if (fread(shape, sizeof(int), 3, file) != 3 || shape[0] < 1 || shape[1] < 1 || shape[2] < 0) {
+        return NULL;
+    }
+
+    Groups* groups = allocate_groups(shape[0], shape[1], shape[2]);
+    if (groups == NULL) {
+        return NULL;
+    }
+
+    int number_of_groups = groups->number_of_groups;
+    size_t slots = (size_t)number_of_groups * groups->max_group_size;
+
+    int read = fread(groups->members, sizeof(int), slots, file) == slots
+        && fread(groups->group_size, sizeof(int), number_of_groups, file) == (size_t)number_of_groups
+        && fread(groups->points, sizeof(int), number_of_groups, file) == (size_t)number_of_groups
+        && fread(groups->happiness, sizeof(float), number_of_groups, file) == (size_t)number_of_groups
+        && fread(groups->group_of, sizeof(int), groups->num_students, file) == (size_t)groups->num_students;
+
+    if (!read) {
+        free_groups(groups);
+        return NULL;
+    }
+    return groups;
+}
+
+/**
+ * Saves a checkpoint. It is written to a temporary file first and then
+ * renamed over the old one, so a crash never leaves a half written checkpoint
+ * Return: int, 0 for fail, 1 for success
+ *
+ * Inputs
+ *  - checkpoint    The state to save
+ *  - filename      Filename to save to
+ * Outputs
+ *  - Checkpoint file
+ *
+ */
+int save_checkpoint(Checkpoint* checkpoint, char filename[]) {
+    char* temp_filename = (char*)malloc(strlen(filename) + 5);
+    if (temp_filename == NULL) {
+        return 0;
+    }
+    sprintf(temp_filename, "%s.tmp", filename);
+
+    FILE* file = fopen(temp_filename, "wb");
+    if (file == NULL) {
+        free(temp_filename);
+        return 0;
+    }
+
+    int version = CHECKPOINT_VERSION;
+    int has_snapshot = checkpoint->snapshot != NULL;
+    int has_open = checkpoint->open_groups != NULL;
+
+    int written = fwrite(CHECKPOINT_MAGIC, 1, 4, file) == 4
+        && fwrite(&version, sizeof(int), 1, file) == 1
+        && fwrite(&checkpoint->fingerprint, sizeof(unsigned long long), 1, file) == 1
+        && fwrite(&checkpoint->iterations, sizeof(long long), 1, file) == 1
+        && fwrite(&checkpoint->accepted, sizeof(long long), 1, file) == 1
+        && fwrite(&checkpoint->elapsed, sizeof(double), 1, file) == 1
+        && fwrite(&checkpoint->stalled, sizeof(int), 1, file) == 1
+        && fwrite(&checkpoint->score, sizeof(long long), 1, file) == 1
+        && fwrite(&checkpoint->best_score, sizeof(long long), 1, file) == 1
+        && fwrite(&checkpoint->temperature, sizeof(float), 1, file) == 1
+        && fwrite(&checkpoint->cycle_temperature, sizeof(float), 1, file) == 1
+        && fwrite(&checkpoint->cycle_start, sizeof(double), 1, file) == 1
+        && fwrite(&checkpoint->last_improvement, sizeof(double), 1, file) == 1
+        && fwrite(checkpoint->rng.s, sizeof(unsigned long long), 4, file) == 4
+        && write_groups(checkpoint->groups, file)
+        && fwrite(&has_snapshot, sizeof(int), 1, file) == 1
+        && (!has_snapshot || (write_groups(checkpoint->snapshot, file)
+            && fwrite(&checkpoint->snapshot_score, sizeof(long long), 1, file) == 1))
+        && fwrite(&has_open, sizeof(int), 1, file) == 1
+        && (!has_open || (fwrite(&checkpoint->open_count, sizeof(int), 1, file) == 1
+            && fwrite(checkpoint->open_groups, sizeof(int), checkpoint->open_count, file) == (size_t)checkpoint->open_count));
+
+    /* Make sure it actually reached the disk before replacing the old checkpoint */
+    written = written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written = (fclose(file) == 0) && written;
+
+    if (!written || rename(temp_filename, filename) != 0) {
+        remove(temp_filename);
+        free(temp_filename);
+        return 0;
+    }
+    free(temp_filename);
+
+    if (DEBUG) {
+        printf("[DEBUG] Saved checkpoint at iteration %lld to %s\n", checkpoint->iterations, filename);
+    }
+    return 1;
+}
+
+/**
+ * Loads a checkpoint
+ * Return: checkpoint pointer, NULL if the file is missing, invalid or cut short
+ *
+ * Inputs
+ *  - filename      Filename to load from
+ * Outputs
+ *  - Newly allocated checkpoint, free with free_checkpoint()
+ *
+ */
+Checkpoint* load_checkpoint(char filename[]) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    Checkpoint* checkpoint = (Checkpoint*)calloc(1, sizeof(Checkpoint));
+    if (checkpoint == NULL) {
+        fclose(file);
+        return NULL;
+    }
+
+    char magic[4];
+    int version = 0;
+    int has_snapshot = 0;
+    int has_open = 0;
+
+    int read = fread(magic, 1, 4, file) == 4 && memcmp(magic, CHECKPOINT_MAGIC, 4) == 0
+        && fread(&version, sizeof(int), 1, file) == 1 && version == CHECKPOINT_VERSION
+        && fread(&checkpoint->fingerprint, sizeof(unsigned long long), 1, file) == 1
+        && fread(&checkpoint->iterations, sizeof(long long), 1, file) == 1
+        && fread(&checkpoint->accepted, sizeof(long long), 1, file) == 1
+        && fread(&checkpoint->elapsed, sizeof(double), 1, file) == 1
+        && fread(&checkpoint->stalled, sizeof(int), 1, file) == 1
+        && fread(&checkpoint->score, sizeof(long long), 1, file) == 1
+        && fread(&checkpoint->best_score, sizeof(long long), 1, file) == 1
+        && fread(&checkpoint->temperature, sizeof(float), 1, file) == 1
+        && fread(&checkpoint->cycle_temperature, sizeof(float), 1, file) == 1
+        && fread(&checkpoint->cycle_start, sizeof(double), 1, file) == 1
+        && fread(&checkpoint->last_improvement, sizeof(double), 1, file) == 1
+        && fread(checkpoint->rng.s, sizeof(unsigned long long), 4, file) == 4
+        && (checkpoint->groups = read_groups(file)) != NULL
+        && fread(&has_snapshot, sizeof(int), 1, file) == 1
+        && (!has_snapshot || ((checkpoint->snapshot = read_groups(file)) != NULL
+            && fread(&checkpoint->snapshot_score, sizeof(long long), 1, file) == 1))
+        && fread(&has_open, sizeof(int), 1, file) == 1;
+
+    /* The open groups list always has room for every group */
+    if (read && has_open) {
+        int number_of_groups = checkpoint->groups->number_of_groups;
+        checkpoint->open_groups = (int*)malloc(sizeof(int) * number_of_groups);
+
+        read = checkpoint->open_groups != NULL
+            && fread(&checkpoint->open_count, sizeof(int), 1, file) == 1
+            && checkpoint->open_count >= 0 && checkpoint->open_count <= number_of_groups
+            && fread(checkpoint->open_groups, sizeof(int), checkpoint->open_count, file) == (size_t)checkpoint->open_count;
+    }
+
+    fclose(file);
+
+    if (!read) {
+        free_checkpoint(checkpoint);
+        return NULL;
+    }
+    return checkpoint;
+}
+
+/**
+ * Frees a checkpoint and everything it holds
+ * Return: void
+ *
+ * Inputs
+ *  - checkpoint    The checkpoint to free, can be NULL
+ * Outputs
+ *  - Deallocated memory
+ *
+ */
+void free_checkpoint(Checkpoint* checkpoint) {
+    if (checkpoint == NULL) {
+        return;
+    }
+
+    free_groups(checkpoint->groups);
+    free_groups(checkpoint->snapshot);
+    free(checkpoint->open_groups);
+    free(checkpoint);
+}
@@ -0,0 +1,11 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "../global/global.h" /* standard libraries, consts, structs */
+
+unsigned long long roster_fingerprint(Roster* roster, Groups* groups);
+int save_checkpoint(Checkpoint* checkpoint, char filename[]);
+Checkpoint* load_checkpoint(char filename[]);
+void free_checkpoint(Checkpoint* checkpoint);
+
+#endif
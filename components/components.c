@@ -0,0 +1,547 @@
+/*******************************************************************************
+ * components.c
+ * Splits the students into groups of friends that never list anyone outside
+ * of their own group, so each one can be solved on its own
+*******************************************************************************/
+
+/*******************************************************************************
+ * Function prototypes
+*******************************************************************************/
+
+#include "components.h"
+
+#include <pthread.h>    /* pthread_create, pthread_join, pthread_mutex_t */
+
+#include "../student/student.h" /* find_together free_roster */
+#include "../group/group.h"     /* allocate_groups create_groups average_happiness free_groups */
+#include "../solver/solver.h"   /* solve use_points_kernel set_group_happiness size_weight score_bound */
+#include "../utils/utils.h"     /* time_ms */
+
+/*******************************************************************************
+ * Global variables
+*******************************************************************************/
+
+extern int DEBUG;
+
+/* A component of the preference graph, solved as its own problem when it can't fit in one group */
+typedef struct {
+    int* students;          /* Dense indices into the full roster, in ascending order */
+    int count;
+    Roster* roster;         /* Students of the component only, NULL until solved */
+    Groups* groups;
+    SolverConfig config;
+    SolverReport report;
+    int solved;
+} Component;
+
+/* Components waiting for a solver thread */
+typedef struct {
+    pthread_mutex_t lock;
+    int next;               /* Next component to hand out */
+    int count;
+    Component* components;
+    Roster* roster;
+    int* local;             /* Dense index -> index within its component, components never share students */
+    int max_group_size;
+    int workers;            /* Threads taking from the queue */
+    int students_left;      /* Students of the components not handed out yet */
+    double deadline;        /* time_ms() every component has to be solved by, 0 for no limit */
+} ComponentQueue;
+
+/**
+ * Finds the connected components of the preference graph, a student is
+ * connected to everyone they list, everyone that lists them, and their
+ * must-be-together set
+ * Return: int, the number of components
+ *
+ * Inputs
+ *  - roster                Dense students
+ *  - component_start       num_students + 1 ints, filled with offsets into component_students
+ *  - component_students    num_students ints, filled with the students of each component
+ * Outputs
+ *  - Components in the order of their first student, each in ascending order
+ *    Returns -1 if allocation failed
+ *
+ */
+int find_components(Roster* roster, int* component_start, int* component_students) {
+    int num_students = roster->num_students;
+    int* parent = (int*)malloc(sizeof(int) * (num_students + 1));
+    int* component = (int*)malloc(sizeof(int) * (num_students + 1));
+    if (parent == NULL || component == NULL) {
+        free(parent);
+        free(component);
+        return -1;
+    }
+
+    for (int i = 0; i < num_students; i++) {
+        parent[i] = i;
+    }
+
+    /* Merge like the must-be-together sets, so the lowest index is always the root */
+    for (int i = 0; i < num_students; i++) {
+        for (int j = 0; j <= MAX_STUDENT_PREFERENCES; j++) {
+            int other = -1;
+            if (j < MAX_STUDENT_PREFERENCES) {
+                other = roster->preferences[i * MAX_STUDENT_PREFERENCES + j];
+            } else if (roster->together != NULL) {
+                other = roster->together[i];
+            }
+            if (other == -1) {
+                continue;
+            }
+
+            int root_a = find_together(parent, i);
+            int root_b = find_together(parent, other);
+            if (root_a < root_b) {
+                parent[root_b] = root_a;
+            } else {
+                parent[root_a] = root_b;
+            }
+        }
+    }
+
+    /* Number the components by their root, which is always their first student */
+    int count = 0;
+    for (int i = 0; i <= num_students; i++) {
+        component_start[i] = 0;
+    }
+    for (int i = 0; i < num_students; i++) {
+        int root = find_together(parent, i);
+        component[i] = (root == i) ? count++ : component[root];
+        component_start[component[i] + 1]++;
+    }
+
+    for (int i = 0; i < count; i++) {
+        component_start[i + 1] += component_start[i];
+    }
+
+    int* fill = parent; /* The roots are no longer needed, reuse them as fill positions */
+    memcpy(fill, component_start, sizeof(int) * count);
+    for (int i = 0; i < num_students; i++) {
+        component_students[fill[component[i]]++] = i;
+    }
+
+    free(parent);
+    free(component);
+    return count;
+}
+
+/**
+ * Builds a roster of just the students of one component, none of their
+ * preferences or together sets lead outside of it
+ * Return: Roster pointer, NULL if allocation failed
+ *
+ * Inputs
+ *  - roster        Dense students
+ *  - students      Students of the component, in ascending order
+ *  - count         Number of students in the component
+ *  - local         Scratch of num_students ints, the index of each student within the component is written to it
+ * Outputs
+ *  - Newly allocated roster, free with free_roster()
+ *
+ */
+Roster* component_roster(Roster* roster, int* students, int count, int* local) {
+    Roster* component = (Roster*)malloc(sizeof(Roster));
+    if (component == NULL) {
+        return NULL;
+    }
+
+    component->num_students = count;
+    component->student_ids = (int*)malloc(sizeof(int) * (count + 1));
+    component->preferences = (int*)malloc(sizeof(int) * (count * MAX_STUDENT_PREFERENCES + 1));
+    component->preferences_size = (int*)malloc(sizeof(int) * (count + 1));
+    component->listed_by_start = (int*)calloc(count + 1, sizeof(int));
+    component->listed_by = (int*)malloc(sizeof(int) * (count * MAX_STUDENT_PREFERENCES + 1));
+    component->together = NULL;
+    component->pinned = NULL;
+    component->apart_start = NULL;
+    component->apart = NULL;
+
+    if (component->student_ids == NULL || component->preferences == NULL || component->preferences_size == NULL ||
+        component->listed_by_start == NULL || component->listed_by == NULL) {
+        free_roster(component);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        local[students[i]] = i;
+    }
+
+    /* Rewrite the preferences as component indices, counting how often each student is listed */
+    for (int i = 0; i < count; i++) {
+        int student = students[i];
+        component->student_ids[i] = roster->student_ids[student];
+        component->preferences_size[i] = roster->preferences_size[student];
+
+        for (int j = 0; j < MAX_STUDENT_PREFERENCES; j++) {
+            int preference = roster->preferences[student * MAX_STUDENT_PREFERENCES + j];
+            if (preference != -1) {
+                preference = local[preference];
+                component->listed_by_start[preference + 1]++;
+            }
+            component->preferences[i * MAX_STUDENT_PREFERENCES + j] = preference;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        component->listed_by_start[i + 1] += component->listed_by_start[i];
+    }
+
+    int* fill = local; /* Only the component's own entries were written, reuse them as fill positions */
+    for (int i = 0; i < count; i++) {
+        fill[students[i]] = component->listed_by_start[i];
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < MAX_STUDENT_PREFERENCES; j++) {
+            int preference = component->preferences[i * MAX_STUDENT_PREFERENCES + j];
+            if (preference != -1) {
+                component->listed_by[fill[students[preference]]++] = i;
+            }
+        }
+    }
+
+    if (roster->together == NULL) {
+        return component;
+    }
+
+    /* The first student of a set stays the first, the component keeps the input order */
+    for (int i = 0; i < count; i++) {
+        local[students[i]] = i;
+    }
+
+    component->together = (int*)malloc(sizeof(int) * (count + 1));
+    component->pinned = (int*)malloc(sizeof(int) * (count + 1));
+    component->apart_start = (int*)calloc(count + 1, sizeof(int));
+    component->apart = (int*)malloc(sizeof(int));
+    if (component->together == NULL || component->pinned == NULL || component->apart_start == NULL || component->apart == NULL) {
+        free_roster(component);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        component->together[i] = local[roster->together[students[i]]];
+        component->pinned[i] = roster->pinned[students[i]];
+    }
+
+    return component;
+}
+
+/**
+ * Sorts components from the most students to the fewest, ties keep the
+ * order of their first student so the result doesn't depend on qsort
+ * Return: int
+ *
+ * Inputs
+ *  - a             First component
+ *  - b             Second component
+ * Outputs
+ *  - Comparison result
+ *
+ */
+int cmp_component_size(const void* a, const void* b) {
+    const Component* first = (const Component*)a;
+    const Component* second = (const Component*)b;
+    if (first->count != second->count) {
+        return second->count - first->count;
+    }
+    return (first->students[0] > second->students[0]) - (first->students[0] < second->students[0]);
+}
+
+/**
+ * Solves components from the queue until it is empty
+ * Return: void*, always NULL (pthread entry point)
+ *
+ * Inputs
+ *  - arg           The ComponentQueue to take from
+ * Outputs
+ *  - Solved groups of each component taken
+ *
+ */
+void* solve_queued(void* arg) {
+    ComponentQueue* queue = (ComponentQueue*)arg;
+
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        int next = queue->next++;
+        int students_left = queue->students_left;
+        if (next < queue->count) {
+            queue->students_left -= queue->components[next].count;
+        }
+        pthread_mutex_unlock(&queue->lock);
+
+        if (next >= queue->count) {
+            break;
+        }
+
+        Component* component = &queue->components[next];
+        component->roster = component_roster(queue->roster, component->students, component->count, queue->local);
+        if (component->roster != NULL) {
+            component->groups = create_groups(component->roster, queue->max_group_size, component->config.init);
+        }
+        if (component->groups != NULL) {
+            /* Each thread gets what is left of time_limit, shared out by the students not handed out yet */
+            if (queue->deadline > 0) {
+                double left = queue->deadline - time_ms();
+                double share = left * queue->workers * component->count / students_left;
+                if (share > left) {
+                    share = left;
+                }
+                component->config.time_limit = (share < 1) ? 1 : (int)share;
+            }
+            component->solved = solve(component->roster, component->groups, &component->config, &component->report);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Frees the students and groups of every solved component
+ * Return: void
+ *
+ * Inputs
+ *  - components    The components
+ *  - count         Number of components
+ * Outputs
+ *  - Deallocated memory
+ *
+ */
+void free_components(Component* components, int count) {
+    for (int i = 0; i < count; i++) {
+        free_roster(components[i].roster);
+        free_groups(components[i].groups);
+    }
+    free(components);
+}
+
+/**
+ * Solves each connected component of the preference graph on its own.
+ * Components that fit in a group are packed whole, best fit from the largest
+ * down, into the room the solved components left and then into new groups.
+ * The rest are solved at once on a pool of config->threads threads, sharing
+ * out the time limit by size. Students apart from someone link the whole
+ * cohort, so constraints with apart pairs are solved as one problem instead
+ * Return: int, 0 fail, 1 success
+ *
+ * Inputs
+ *   roster             Dense students
+ *   groups             Groups to replace, only used as is when not decomposing
+ *   config             Solver parameters
+ *   report             Filled in with how the run went, summed over the components, can be NULL
+ * Outputs
+ *  - Newly allocated merged groups in *groups, the old ones are freed, success state
+ *
+ */
+int solve_components(Roster* roster, Groups** groups, SolverConfig* config, SolverReport* report) {
+    int num_students = roster->num_students;
+    int max_group_size = (*groups)->max_group_size;
+
+    if (roster->apart_start != NULL && roster->apart_start[num_students] > 0) {
+        if (DEBUG) {
+            printf("[DEBUG] Apart constraints link the components, solving as one problem\n");
+        }
+        return solve(roster, *groups, config, report);
+    }
+
+    if (config->checkpoint != NULL || config->trace != NULL) {
+        printf("Components are solved separately and can't be checkpointed, resumed or traced\n");
+        return 0;
+    }
+
+    double start_time = time_ms();
+    int* component_start = (int*)malloc(sizeof(int) * (num_students + 1));
+    int* component_students = (int*)malloc(sizeof(int) * (num_students + 1));
+    int* local = (int*)malloc(sizeof(int) * (num_students + 1));
+    int count = -1;
+    if (component_start != NULL && component_students != NULL && local != NULL) {
+        count = find_components(roster, component_start, component_students);
+    }
+
+    Component* components = (count > 0) ? (Component*)calloc(count, sizeof(Component)) : NULL;
+    if (components == NULL) {
+        free(component_start);
+        free(component_students);
+        free(local);
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        components[i].students = &component_students[component_start[i]];
+        components[i].count = component_start[i + 1] - component_start[i];
+    }
+    free(component_start);
+
+    /* Largest first, so the longest solves start first and the packing is best fit decreasing */
+    qsort(components, count, sizeof(Component), cmp_component_size);
+
+    int num_large = 0;
+    int large_students = 0;
+    while (num_large < count && components[num_large].count > max_group_size) {
+        large_students += components[num_large].count;
+        num_large++;
+    }
+
+    /* Spread the threads over the components, a lone large component gets all of them */
+    int workers = (config->threads < num_large) ? config->threads : num_large;
+    for (int i = 0; i < num_large; i++) {
+        Component* component = &components[i];
+        component->config = *config;
+        component->config.threads = config->threads / workers;
+        component->config.seed = config->seed + i;
+    }
+
+    if (DEBUG) {
+        printf("[DEBUG] Found %d components, largest has %d students\n", count, components[0].count);
+        printf("[DEBUG] Solving %d components (%d students) on %d threads, packing %d whole\n", num_large, large_students, workers, count - num_large);
+    }
+
+    /* Every component has the same group size, pick the scoring kernel before any thread can read it */
+    use_points_kernel(max_group_size);
+
+    ComponentQueue queue;
+    pthread_mutex_init(&queue.lock, NULL);
+    queue.next = 0;
+    queue.count = num_large;
+    queue.components = components;
+    queue.roster = roster;
+    queue.local = local;
+    queue.max_group_size = max_group_size;
+    queue.workers = workers;
+    queue.students_left = large_students;
+    queue.deadline = (config->time_limit > 0) ? start_time + config->time_limit : 0;
+
+    if (workers > 1) {
+        pthread_t* handles = (pthread_t*)malloc(sizeof(pthread_t) * workers);
+        int started = 0;
+        while (handles != NULL && started < workers - 1 && pthread_create(&handles[started], NULL, solve_queued, &queue) == 0) {
+            started++;
+        }
+
+        /* This thread is the last worker, and solves whatever the others couldn't be started for */
+        solve_queued(&queue);
+        for (int i = 0; i < started; i++) {
+            pthread_join(handles[i], NULL);
+        }
+        free(handles);
+    } else {
+        solve_queued(&queue);
+    }
+    pthread_mutex_destroy(&queue.lock);
+    free(local);
+
+    /* Every solved group keeps its slot, plus at worst a new group for each packed component */
+    int most_groups = count - num_large;
+    for (int i = 0; i < num_large; i++) {
+        if (!components[i].solved) {
+            free_components(components, count);
+            free(component_students);
+            return 0;
+        }
+        most_groups += components[i].groups->number_of_groups;
+    }
+
+    Groups* merged = allocate_groups(most_groups, max_group_size, num_students);
+    int* room_head = (int*)malloc(sizeof(int) * (max_group_size + 1));
+    int* room_next = (int*)malloc(sizeof(int) * (most_groups + 1));
+    if (merged == NULL || room_head == NULL || room_next == NULL) {
+        free_groups(merged);
+        free(room_head);
+        free(room_next);
+        free_components(components, count);
+        free(component_students);
+        return 0;
+    }
+
+    /* Groups with room are kept in a list for each amount of room left */
+    for (int i = 0; i <= max_group_size; i++) {
+        room_head[i] = -1;
+    }
+
+    int used = 0;
+    for (int i = 0; i < num_large; i++) {
+        Groups* solved = components[i].groups;
+        for (int g = 0; g < solved->number_of_groups; g++) {
+            int size = solved->group_size[g];
+            if (size == 0) {
+                continue;
+            }
+
+            for (int j = 0; j < size; j++) {
+                int student = components[i].students[solved->members[g * max_group_size + j]];
+                merged->members[used * max_group_size + j] = student;
+                merged->group_of[student] = used;
+            }
+            merged->group_size[used] = size;
+
+            if (size < max_group_size) {
+                room_next[used] = room_head[max_group_size - size];
+                room_head[max_group_size - size] = used;
+            }
+            used++;
+        }
+    }
+
+    /* Each small component goes whole into the tightest room it fits, or a new group */
+    for (int i = num_large; i < count; i++) {
+        Component* component = &components[i];
+        int room = component->count;
+        while (room <= max_group_size && room_head[room] == -1) {
+            room++;
+        }
+
+        int group;
+        if (room <= max_group_size) {
+            group = room_head[room];
+            room_head[room] = room_next[group];
+        } else {
+            group = used++;
+            room = max_group_size;
+        }
+
+        for (int j = 0; j < component->count; j++) {
+            merged->members[group * max_group_size + merged->group_size[group]] = component->students[j];
+            merged->group_of[component->students[j]] = group;
+            merged->group_size[group]++;
+        }
+
+        room -= component->count;
+        if (room > 0) {
+            room_next[group] = room_head[room];
+            room_head[room] = group;
+        }
+    }
+    free(room_head);
+    free(room_next);
+
+    merged->number_of_groups = used;
+    for (int g = 0; g < used; g++) {
+        set_group_happiness(roster, merged, g);
+    }
+
+    if (report != NULL) {
+        report->iterations = 0;
+        report->accepted = 0;
+        for (int i = 0; i < num_large; i++) {
+            report->iterations += components[i].report.iterations;
+            report->accepted += components[i].report.accepted;
+        }
+
+        /* The largest component decides why the run stopped, with none every component is whole */
+        report->stop_reason = (num_large > 0) ? components[0].report.stop_reason : STOP_OPTIMAL;
+        report->elapsed = time_ms() - start_time;
+        report->refine_elapsed = (num_large > 0) ? components[0].report.refine_elapsed : 0;
+        report->score = average_happiness(merged);
+        score_bound(roster, merged, size_weight(max_group_size), 0, &report->bound);
+    }
+
+    if (DEBUG) {
+        printf("[DEBUG] Merged the components into %d groups (%.0f ms)\n", used, time_ms() - start_time);
+    }
+
+    free_components(components, count);
+    free(component_students);
+    free_groups(*groups);
+    *groups = merged;
+    return 1;
+}
@@ -0,0 +1,10 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include "../global/global.h" /* standard libraries, consts, structs */
+
+int find_components(Roster* roster, int* component_start, int* component_students);
+Roster* component_roster(Roster* roster, int* students, int count, int* local);
+int solve_components(Roster* roster, Groups** groups, SolverConfig* config, SolverReport* report);
+
+#endif
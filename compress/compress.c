@@ -112,7 +112,7 @@ int* find_unique(int* int_student_arr, int int_student_arr_size, int* num_unique
         
         /* Check if they are already in the list*/
         int found = 0;
-        for (int j = 0; j < int_student_arr_size; j++) {
+        for (int j = 0; j < *num_unique; j++) {
             if (int_student_arr[i] == unique_student_ids[j]) {
                 found = 1;
             }
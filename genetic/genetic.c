@@ -0,0 +1,494 @@
+/*******************************************************************************
+ * genetic.c
+ * Breeds a population of groupings, keeping the groups that work and
+ * reshuffling the students around them
+*******************************************************************************/
+
+/*******************************************************************************
+ * Function prototypes
+*******************************************************************************/
+
+#include "genetic.h"
+
+#include <pthread.h>    /* pthread_create, pthread_join */
+
+#include "../group/group.h"   /* copy_groups copy_groups_into free_groups place_with_preferences */
+#include "../solver/solver.h" /* set_group_happiness swap_students */
+#include "../rng/rng.h"       /* rng_stream rng_below */
+#include "../utils/utils.h"   /* time_ms */
+
+/*******************************************************************************
+ * Global variables
+*******************************************************************************/
+
+extern int DEBUG;
+
+/*
+    Constants
+*/
+#define POPULATION_SIZE     32      /* Groupings kept each generation */
+#define ELITE_SIZE          2       /* Best groupings copied unchanged into the next generation */
+#define TOURNAMENT_SIZE     3       /* Groupings compared when picking a parent */
+#define MUTATION_SWAPS      3       /* Most random swaps made to each child */
+#define GENERATION_SCALE    20      /* Generations for each unit of (1.5 + confidence^2) */
+
+/* A group of one of the parents, ranked by happiness during crossover */
+typedef struct {
+    float happiness;
+    int group;
+    int parent;
+} RankedGroup;
+
+/* State of a single breeding thread */
+typedef struct {
+    Roster* roster;
+    Groups** population;    /* Current generation, only read while breeding */
+    float* fitness;         /* Sum of the group happiness of each grouping */
+    Groups** next;          /* Next generation, children are written here */
+    float* next_fitness;
+    int first;              /* First child of next this thread breeds */
+    int last;               /* One past the last child this thread breeds */
+    Rng rng;                /* Private random stream */
+
+    /* Scratch space for crossover */
+    int* capacity;          /* Number of students each child group will end up with */
+    int* links;             /* Zeroed tally for place_student() */
+    int* by_capacity;       /* Child group indices sorted by capacity */
+    int* size_start;        /* max_group_size + 2 offsets into by_capacity */
+    int* size_next;         /* Next unused group of each capacity */
+    RankedGroup* ranked;    /* Every group of both parents */
+} Breeder;
+
+/**
+ * Orders groups from happiest to least happy, ties broken by parent then index
+ * Return: int, qsort comparison
+ *
+ * Inputs
+ *   a          Pointer to the first RankedGroup
+ *   b          Pointer to the second RankedGroup
+ * Outputs
+ *  - Negative if a comes first
+ *
+ */
+int cmp_ranked_group(const void* a, const void* b) {
+    RankedGroup* group_a = (RankedGroup*)a;
+    RankedGroup* group_b = (RankedGroup*)b;
+
+    if (group_a->happiness != group_b->happiness) {
+        return (group_a->happiness < group_b->happiness) ? 1 : -1;
+    }
+    if (group_a->parent != group_b->parent) {
+        return group_a->parent - group_b->parent;
+    }
+    return group_a->group - group_b->group;
+}
+
+/**
+ * Scores a grouping, refreshing the happiness of every group
+ * Return: float, sum of the group happiness
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The grouping to score
+ * Outputs
+ *  - Updated group happiness
+ *
+ */
+float evaluate_fitness(Roster* roster, Groups* groups) {
+    float fitness = 0;
+    for (int i=0; i<groups->number_of_groups; i++) {
+        fitness += set_group_happiness(roster, groups, i);
+    }
+    return fitness;
+}
+
+/**
+ * Swaps random students between random groups, without looking at the score
+ * Return: void
+ *
+ * Inputs
+ *   groups     The grouping to mutate
+ *   swaps      The number of swaps to make
+ *   rng        Random stream
+ * Outputs
+ *  - Shuffled groups, happiness is left stale
+ *
+ */
+void mutate(Groups* groups, int swaps, Rng* rng) {
+    int number_of_groups = groups->number_of_groups;
+
+    for (int i=0; i<swaps; i++) {
+        int g1 = (int) rng_below(rng, number_of_groups);
+        int g2 = (int) rng_below(rng, number_of_groups);
+        if (g1 == g2 || groups->group_size[g1] == 0 || groups->group_size[g2] == 0) {
+            continue;
+        }
+
+        int s1 = (int) rng_below(rng, groups->group_size[g1]);
+        int s2 = (int) rng_below(rng, groups->group_size[g2]);
+        swap_students(groups, g1, g2, s1, s2);
+    }
+}
+
+/**
+ * Picks the fittest of a few random groupings
+ * Return: int, index of the winner in the population
+ *
+ * Inputs
+ *   fitness    Fitness of each grouping in the population
+ *   rng        Random stream
+ * Outputs
+ *  - Parent index
+ *
+ */
+int tournament(float* fitness, Rng* rng) {
+    int winner = (int) rng_below(rng, POPULATION_SIZE);
+    for (int i=1; i<TOURNAMENT_SIZE; i++) {
+        int challenger = (int) rng_below(rng, POPULATION_SIZE);
+        if (fitness[challenger] > fitness[winner]) {
+            winner = challenger;
+        }
+    }
+    return winner;
+}
+
+/**
+ * Group-preserving crossover. The groups of both parents are ranked by
+ * happiness and copied into the child whole, best first, as long as none
+ * of their members have been placed yet. The students left over are then
+ * placed next to their preferences, the same way as the greedy initializer.
+ * Return: void
+ *
+ * Inputs
+ *   breeder    Scratch space of the breeding thread
+ *   parent_a   Grouping whose group sizes the child copies
+ *   parent_b   Second grouping, same students and shape as parent_a
+ *   child      Grouping to overwrite
+ * Outputs
+ *  - Child grouping, happiness is left stale
+ *
+ */
+void crossover(Breeder* breeder, Groups* parent_a, Groups* parent_b, Groups* child) {
+    Roster* roster = breeder->roster;
+    int number_of_groups = parent_a->number_of_groups;
+    int max_group_size = parent_a->max_group_size;
+    Groups* parents[2] = {parent_a, parent_b};
+
+    /* The child has the same group sizes as parent_a, sorted so a group can claim one of its size */
+    for (int i=0; i<max_group_size + 2; i++) {
+        breeder->size_start[i] = 0;
+    }
+    for (int i=0; i<number_of_groups; i++) {
+        breeder->capacity[i] = parent_a->group_size[i];
+        breeder->size_start[breeder->capacity[i] + 1]++;
+        child->group_size[i] = 0;
+    }
+    for (int i=1; i<max_group_size + 2; i++) {
+        breeder->size_start[i] += breeder->size_start[i - 1];
+    }
+    for (int i=0; i<max_group_size + 1; i++) {
+        breeder->size_next[i] = breeder->size_start[i];
+    }
+    for (int i=0; i<number_of_groups; i++) {
+        breeder->by_capacity[breeder->size_next[breeder->capacity[i]]++] = i;
+    }
+    for (int i=0; i<max_group_size + 1; i++) {
+        breeder->size_next[i] = breeder->size_start[i];
+    }
+
+    for (int i=0; i<child->num_students; i++) {
+        child->group_of[i] = -1;
+    }
+
+    /* Rank every group of both parents */
+    for (int p=0; p<2; p++) {
+        for (int i=0; i<number_of_groups; i++) {
+            RankedGroup* ranked = &breeder->ranked[p * number_of_groups + i];
+            ranked->happiness = parents[p]->happiness[i];
+            ranked->group = i;
+            ranked->parent = p;
+        }
+    }
+    qsort(breeder->ranked, number_of_groups * 2, sizeof(RankedGroup), cmp_ranked_group);
+
+    /*
+        Inherit whole groups, skipping any that clash with one already inherited.
+        Groups that satisfy nobody aren't worth keeping, their students are repaired instead
+    */
+    for (int i=0; i<number_of_groups * 2; i++) {
+        Groups* parent = parents[breeder->ranked[i].parent];
+        int group = breeder->ranked[i].group;
+        int size = parent->group_size[group];
+        int* members = &parent->members[group * max_group_size];
+
+        if (size == 0 || breeder->ranked[i].happiness <= 0 || breeder->size_next[size] == breeder->size_start[size + 1]) {
+            continue;
+        }
+
+        int clash = 0;
+        for (int j=0; j<size; j++) {
+            if (child->group_of[members[j]] != -1) {
+                clash = 1;
+                break;
+            }
+        }
+        if (clash) {
+            continue;
+        }
+
+        int slot = breeder->by_capacity[breeder->size_next[size]++];
+        for (int j=0; j<size; j++) {
+            child->members[slot * max_group_size + j] = members[j];
+            child->group_of[members[j]] = slot;
+        }
+        child->group_size[slot] = size;
+    }
+
+    /* Repair, the students left over join whichever open group they are most linked to */
+    int next_open = 0;
+    for (int i=0; i<child->num_students; i++) {
+        if (child->group_of[i] == -1) {
+            place_with_preferences(roster, child, breeder->capacity, breeder->links, &next_open, i);
+        }
+    }
+}
+
+/**
+ * Breeds and scores this thread's share of the next generation
+ * Return: void*, always NULL (pthread entry point)
+ *
+ * Inputs
+ *   arg        Pointer to the breeder to run
+ * Outputs
+ *  - Children and their fitness in the next generation
+ *
+ */
+void* breed(void* arg) {
+    Breeder* breeder = (Breeder*)arg;
+
+    for (int i=breeder->first; i<breeder->last; i++) {
+        int parent_a = tournament(breeder->fitness, &breeder->rng);
+        int parent_b = tournament(breeder->fitness, &breeder->rng);
+
+        crossover(breeder, breeder->population[parent_a], breeder->population[parent_b], breeder->next[i]);
+        mutate(breeder->next[i], 1 + (int) rng_below(&breeder->rng, MUTATION_SWAPS), &breeder->rng);
+        breeder->next_fitness[i] = evaluate_fitness(breeder->roster, breeder->next[i]);
+    }
+
+    return NULL;
+}
+
+/**
+ * Frees the populations and the breeders' scratch space
+ * Return: void
+ *
+ * Inputs
+ *   population     Current generation, entries can be NULL
+ *   next           Next generation, entries can be NULL
+ *   breeders       Breeding threads
+ *   threads        Number of breeders
+ * Outputs
+ *  - Deallocated memory
+ *
+ */
+void free_genetic(Groups** population, Groups** next, Breeder* breeders, int threads) {
+    for (int i=0; i<POPULATION_SIZE; i++) {
+        free_groups(population[i]);
+        free_groups(next[i]);
+    }
+
+    for (int i=0; i<threads; i++) {
+        free(breeders[i].capacity);
+        free(breeders[i].links);
+        free(breeders[i].by_capacity);
+        free(breeders[i].size_start);
+        free(breeders[i].size_next);
+        free(breeders[i].ranked);
+    }
+}
+
+/**
+ * Runs a genetic algorithm starting from the given groups: tournament
+ * selection, group-preserving crossover and swap mutation, with the best
+ * groupings carried over between generations. Each thread breeds and scores
+ * its own share of every generation.
+ * Return: int, 0 fail, 1 success
+ *
+ * Inputs
+ *   roster             Dense students
+ *   groups             The groups to improve, happiness must be up to date
+ *   config             Solver parameters
+ *   start_time         time_ms() when solving started
+ *   report             Filled in with how the run went, elapsed is left alone
+ * Outputs
+ *  - Best grouping found, written into groups
+ *
+ */
+int solve_genetic(Roster* roster, Groups* groups, SolverConfig* config, double start_time, SolverReport* report) {
+    int number_of_groups = groups->number_of_groups;
+    int max_group_size = groups->max_group_size;
+
+    int threads = config->threads;
+    if (threads > POPULATION_SIZE - ELITE_SIZE) {
+        threads = POPULATION_SIZE - ELITE_SIZE;
+    }
+
+    Groups* population[POPULATION_SIZE] = {NULL};
+    Groups* next[POPULATION_SIZE] = {NULL};
+    float fitness[POPULATION_SIZE];
+    float next_fitness[POPULATION_SIZE];
+    Breeder breeders[POPULATION_SIZE];
+    pthread_t handles[POPULATION_SIZE];
+    memset(breeders, 0, sizeof(breeders));
+
+    int allocated = 1;
+    for (int i=0; i<POPULATION_SIZE; i++) {
+        population[i] = copy_groups(groups);
+        next[i] = copy_groups(groups);
+        allocated = allocated && population[i] != NULL && next[i] != NULL;
+    }
+
+    /* Each breeder gets an even share of the children and its own random stream */
+    int children = POPULATION_SIZE - ELITE_SIZE;
+    for (int i=0; i<threads; i++) {
+        Breeder* breeder = &breeders[i];
+        breeder->roster = roster;
+        breeder->first = ELITE_SIZE + children * i / threads;
+        breeder->last = ELITE_SIZE + children * (i + 1) / threads;
+        rng_stream(&breeder->rng, config->seed, i + 1);
+
+        breeder->capacity = (int*)malloc(sizeof(int) * number_of_groups);
+        breeder->links = (int*)calloc(number_of_groups, sizeof(int));
+        breeder->by_capacity = (int*)malloc(sizeof(int) * number_of_groups);
+        breeder->size_start = (int*)malloc(sizeof(int) * (max_group_size + 2));
+        breeder->size_next = (int*)malloc(sizeof(int) * (max_group_size + 2));
+        breeder->ranked = (RankedGroup*)malloc(sizeof(RankedGroup) * number_of_groups * 2);
+
+        allocated = allocated && breeder->capacity != NULL && breeder->links != NULL && breeder->by_capacity != NULL
+            && breeder->size_start != NULL && breeder->size_next != NULL && breeder->ranked != NULL;
+    }
+
+    if (!allocated) {
+        free_genetic(population, next, breeders, threads);
+        return 0;
+    }
+
+    /*
+        The first grouping is the one we were given, the rest are
+        increasingly shuffled copies of it so the population starts diverse
+    */
+    Rng rng;
+    rng_stream(&rng, config->seed, 0);
+    for (int i=0; i<POPULATION_SIZE; i++) {
+        mutate(population[i], i * roster->num_students / (2 * POPULATION_SIZE), &rng);
+        fitness[i] = evaluate_fitness(roster, population[i]);
+    }
+
+    long long num_generations = (1.5 + config->confidence * config->confidence) * GENERATION_SCALE;
+    if (config->time_limit > 0) {
+        num_generations = -1;
+    }
+
+    float best_fitness = fitness[0];
+    long long generations = 0;
+    long long bred = 0;
+    long long improved = 0;
+    long long stalled = 0;
+    int stop_reason = STOP_ITERATIONS;
+
+    while (1) {
+        if (num_generations >= 0 && generations >= num_generations) {
+            stop_reason = STOP_ITERATIONS;
+            break;
+        }
+        if (config->time_limit > 0 && time_ms() - start_time >= config->time_limit) {
+            stop_reason = STOP_TIME_LIMIT;
+            break;
+        }
+        if (config->stall_limit > 0 && stalled >= config->stall_limit) {
+            stop_reason = STOP_STALLED;
+            break;
+        }
+
+        /* Carry the best groupings over unchanged */
+        int taken[POPULATION_SIZE] = {0};
+        for (int e=0; e<ELITE_SIZE; e++) {
+            int elite = -1;
+            for (int i=0; i<POPULATION_SIZE; i++) {
+                if (!taken[i] && (elite == -1 || fitness[i] > fitness[elite])) {
+                    elite = i;
+                }
+            }
+            taken[elite] = 1;
+            copy_groups_into(next[e], population[elite]);
+            next_fitness[e] = fitness[elite];
+        }
+
+        /* Breed the rest */
+        int started[POPULATION_SIZE] = {0};
+        for (int i=0; i<threads; i++) {
+            breeders[i].population = population;
+            breeders[i].fitness = fitness;
+            breeders[i].next = next;
+            breeders[i].next_fitness = next_fitness;
+
+            if (threads == 1) {
+                breed(&breeders[i]);
+            } else if (pthread_create(&handles[i], NULL, breed, &breeders[i]) == 0) {
+                started[i] = 1;
+            } else {
+                /* Fall back to breeding this share on the current thread */
+                breed(&breeders[i]);
+            }
+        }
+        for (int i=0; i<threads; i++) {
+            if (started[i]) {
+                pthread_join(handles[i], NULL);
+            }
+        }
+
+        /* The next generation becomes the current one */
+        for (int i=0; i<POPULATION_SIZE; i++) {
+            Groups* swap = population[i];
+            population[i] = next[i];
+            next[i] = swap;
+            fitness[i] = next_fitness[i];
+        }
+
+        generations++;
+        bred += children;
+        stalled += children;
+
+        for (int i=ELITE_SIZE; i<POPULATION_SIZE; i++) {
+            if (fitness[i] > best_fitness) {
+                best_fitness = fitness[i];
+                improved++;
+                stalled = 0;
+            }
+        }
+
+        if (DEBUG && generations % 50 == 0) {
+            printf("[DEBUG] Generation %lld best score: %lf\n", generations, best_fitness / number_of_groups);
+        }
+    }
+
+    /* Keep the fittest grouping */
+    int best = 0;
+    for (int i=1; i<POPULATION_SIZE; i++) {
+        if (fitness[i] > fitness[best]) {
+            best = i;
+        }
+    }
+    copy_groups_into(groups, population[best]);
+
+    if (DEBUG) {
+        printf("[DEBUG] Bred %lld generations of %d groupings\n", generations, POPULATION_SIZE);
+    }
+
+    report->iterations = bred;
+    report->accepted = improved;
+    report->stop_reason = stop_reason;
+
+    free_genetic(population, next, breeders, threads);
+    return 1;
+}
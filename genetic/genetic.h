@@ -0,0 +1,8 @@
+#ifndef GENETIC_H
+#define GENETIC_H
+
+#include "../global/global.h" /* standard libraries, consts, structs */
+
+int solve_genetic(Roster* roster, Groups* groups, SolverConfig* config, double start_time, SolverReport* report);
+
+#endif
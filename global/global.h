@@ -17,10 +17,61 @@
 */
 #define MAX_STUDENT_ID              1000000         /* Used when randomly generating students */
 #define MAX_STUDENT_PREFERENCES     5               /* To allow for 1d conversion */
+#define HAPPINESS_SCALE             60              /* Points for a fully happy student, divisible by every preference count up to MAX_STUDENT_PREFERENCES */
 #define INT_MAX                     2147483647      /* Indicates empty preference */
 #define MAX_LINE_LENGTH             1000            /* Limit when reading csv */
 #define MAX_USR_STR_INP_LEN         256             /* Password and filename input max lengths */
 
+/*
+    Solver schedules, the rule for keeping a swap that makes things worse
+*/
+#define SCHEDULE_FIXED              0               /* Keep with a constant probability p */
+#define SCHEDULE_GEOMETRIC          1               /* Annealing, temperature cools geometrically */
+#define SCHEDULE_ADAPTIVE           2               /* Annealing, reheats when no longer improving */
+
+/*
+    Solver strategies
+*/
+#define STRATEGY_SWAP               0               /* Swap students around a single grouping per thread */
+#define STRATEGY_GENETIC            1               /* Breed a population of groupings */
+#define STRATEGY_LNS                2               /* Dissolve a few linked groups at a time and rebuild them */
+#define STRATEGY_TABU               3               /* Take the best of a sample of swaps, never moving recently moved students back */
+
+/*
+    Moves the swap strategy can make, combined as bit flags
+*/
+#define MOVE_SWAP                   1               /* Swap two students between two groups */
+#define MOVE_RELOCATE               2               /* Move one student into a group with room */
+#define MOVE_ROTATE                 4               /* Rotate three students around three groups */
+
+/*
+    Reasons for the solver to stop
+*/
+#define STOP_ITERATIONS             0               /* Used up the iterations given by confidence */
+#define STOP_TIME_LIMIT             1               /* Used up the time limit */
+#define STOP_STALLED                2               /* No improvement over the last stall_limit accepted swaps */
+#define STOP_OPTIMAL                3               /* Reached the upper bound, nothing better exists */
+
+/*
+    Hard constraints between two students
+*/
+#define CONSTRAINT_TOGETHER         0               /* Must be in the same group */
+#define CONSTRAINT_APART            1               /* Must be in different groups */
+
+/*
+    Vector instructions group scoring can use, picked at runtime
+*/
+#define SIMD_NONE                   0               /* Plain loops */
+#define SIMD_SSE2                   1               /* 4 lanes of 32 bits */
+#define SIMD_AVX2                   2               /* 8 lanes of 32 bits */
+#define SIMD_MAX_SIZE               8               /* Largest group the vectorised scoring handles */
+
+/*
+    Ways to build the groups the solver starts from
+*/
+#define INIT_SEQUENTIAL             0               /* Fill groups in input order */
+#define INIT_GREEDY                 1               /* Place students next to their preferences */
+
 /* Struct to represent a student */
 typedef struct {
     int student_id;
@@ -28,12 +79,115 @@ typedef struct {
     int preferences_size;
 } Student;
 
-/* Struct to represent a group of students */
+/*
+    Struct to represent the students once remapped to dense indices [0, num_students),
+    so the solver can use array lookups instead of comparing raw student ids
+*/
+typedef struct {
+    int num_students;
+    int* student_ids;       /* Dense index -> original student id */
+    int* preferences;       /* num_students * MAX_STUDENT_PREFERENCES dense indices, -1 if unknown */
+    int* preferences_size;  /* Number of preferences per student (unknown ones included) */
+    int* listed_by_start;   /* num_students + 1 offsets into listed_by */
+    int* listed_by;         /* Dense indices of the students that prefer each student */
+
+    /* Hard constraints, all NULL when there are none */
+    int* together;          /* Dense index of the first student of each must-be-together set */
+    int* pinned;            /* 1 if the student shares a must-be-together set, they can't be moved alone */
+    int* apart_start;       /* num_students + 1 offsets into apart */
+    int* apart;             /* Dense indices of the students each student must be apart from */
+} Roster;
+
+/* Struct to represent a constraint read from a file, by student id */
+typedef struct {
+    int student_a;
+    int student_b;
+    int type;               /* One of the CONSTRAINT_ constants */
+} Constraint;
+
+/*
+    Struct to represent every group at once, as parallel arrays in a few
+    contiguous blocks. The members of group g are stored at
+    members[g * max_group_size] up to members[g * max_group_size + group_size[g] - 1]
+*/
+typedef struct {
+    int number_of_groups;
+    int max_group_size;
+    int num_students;
+    int* members;       /* number_of_groups * max_group_size dense student indices */
+    int* group_size;    /* Number of students in each group */
+    int* points;        /* Summed student points of each group, HAPPINESS_SCALE for each fully happy member */
+    float* happiness;   /* Average happiness of each group worked out from points, -1 means it hasn't been computed yet */
+    int* group_of;      /* Dense student index -> group index */
+} Groups;
+
+/* Struct to hold the state of a random number stream (xoshiro256**) */
+typedef struct {
+    unsigned long long s[4];
+} Rng;
+
+/* Shared memory the islands trade groups through, see island.c */
+struct IslandSegment;
+
+/* Struct to hold the parameters that control the solver */
+typedef struct {
+    int confidence;             /* Controls the number of swaps */
+    float p;                    /* Probability to accept a bad swap */
+    int threads;                /* Number of independent solver chains to run at once */
+    unsigned long long seed;    /* Seed of the random streams, same seed gives the same result */
+    int schedule;               /* One of the SCHEDULE_ constants */
+    float temperature;          /* Starting temperature of the annealing schedules */
+    int time_limit;             /* Milliseconds to solve for, replaces confidence when > 0 */
+    int stall_limit;            /* Stop after this many accepted swaps without improving, 0 to never stop */
+    int init;                   /* One of the INIT_ constants */
+    int strategy;               /* One of the STRATEGY_ constants */
+    float directed;             /* [0-1] Fraction of swaps aimed at unmet preferences */
+    int moves;                  /* MOVE_ flags the swap strategy can use */
+    int refine;                 /* 1 to finish with a deterministic refinement pass, 0 to skip it */
+    char* checkpoint;           /* File to save the solver state to every so often, NULL to never save */
+    int checkpoint_interval;    /* Milliseconds between checkpoints */
+    char* resume;               /* Checkpoint file to continue solving from, NULL to start fresh */
+    char* constraints;          /* Constraints file loaded with the students, NULL for none */
+    char* trace;                /* File to sample the solver's progress to, JSON lines if it ends in .jsonl, CSV otherwise, NULL to never sample */
+    int trace_interval;         /* Milliseconds between trace samples */
+    int decompose;              /* 1 to solve each connected component of the preference graph on its own */
+    int islands;                /* Worker processes to solve in, trading groups as they go, 0 to solve in this process */
+    int migration_interval;     /* Iterations between islands trading groups */
+    struct IslandSegment* island_segment; /* Segment of the island being solved, NULL when not solving an island */
+    int island;                 /* Index of the island being solved in island_segment */
+} SolverConfig;
+
+/* Struct to describe how a solver run went */
+typedef struct {
+    long long iterations;       /* Swaps or rebuilds proposed summed over all chains, or children bred */
+    long long accepted;         /* Swaps or rebuilds kept summed over all chains, or children that beat the best */
+    int stop_reason;            /* One of the STOP_ constants */
+    double elapsed;             /* Milliseconds spent solving */
+    double refine_elapsed;      /* Milliseconds of elapsed spent on the final refinement */
+    double score;               /* Final average happiness */
+    double bound;               /* Highest average happiness any grouping could reach */
+} SolverReport;
+
+/* Struct to hold everything needed to continue a swap chain exactly where it stopped */
 typedef struct {
-    int group_size;
-    Student** students;
-    float happiness; /* A happiness of -1 means it hasn't been computed yet */
-} Group;
+    unsigned long long fingerprint; /* Hash of the students and group layout the state belongs to */
+    long long iterations;
+    long long accepted;
+    double elapsed;             /* Milliseconds solved for so far */
+    int stalled;
+    long long score;            /* Exact solver scores, see group_score() */
+    long long best_score;
+    float temperature;
+    float cycle_temperature;
+    double cycle_start;
+    double last_improvement;
+    Rng rng;
+    Groups* groups;
+    Groups* snapshot;           /* NULL if the chain had no snapshot */
+    long long snapshot_score;
+    int open_count;
+    int* open_groups;           /* NULL if the chain wasn't relocating */
+} Checkpoint;
 
 /* Struct to represent a node within huffman tree */
 typedef struct node node;
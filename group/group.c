@@ -20,19 +20,20 @@ extern int DEBUG;
  * Return: void
  *
  * Inputs
- *  - groups                Array of group struct
- *  - number_of_groups      Size of the groups argument
+ *  - groups                The groups to print
+ *  - roster                Dense students, to convert indices back to ids
  * Outputs
  *  - Result csv file OR compressed student preferences
  * 
  */
-void stdout_groups(Group* groups, int number_of_groups) {
-    for (int i = 0; i < number_of_groups; i++) {
+void stdout_groups(Groups* groups, Roster* roster) {
+    for (int i = 0; i < groups->number_of_groups; i++) {
         
-        printf("[Group %03d] %d students: ", i, groups[i].group_size);
+        printf("[Group %03d] %d students: ", i, groups->group_size[i]);
 
-        for (int j = 0; j < groups[i].group_size; j++) {
-            printf("\t%d", groups[i].students[j]->student_id);
+        int* members = &groups->members[i * groups->max_group_size];
+        for (int j = 0; j < groups->group_size[i]; j++) {
+            printf("\t%d", roster->student_ids[members[j]]);
         }
 
         printf("\n");
@@ -44,14 +45,14 @@ void stdout_groups(Group* groups, int number_of_groups) {
  * Return: int, 0 for fail, 1 for success
  *
  * Inputs
- *  - groups                Array of group struct
- *  - number_of_groups      Size of the groups argument
+ *  - groups                The groups to save
+ *  - roster                Dense students, to convert indices back to ids
  *  - filename              Filename to save to
  * Outputs
  *  - Saved groups in a csv file
  * 
  */
-int csv_groups(Group* groups, int number_of_groups, char filename[], int max_group_size) {
+int csv_groups(Groups* groups, Roster* roster, char filename[]) {
     
     /* Open the file */
     FILE * file = fopen(filename, "w");
@@ -59,6 +60,8 @@ int csv_groups(Group* groups, int number_of_groups, char filename[], int max_gro
         return 0;
     }
 
+    int max_group_size = groups->max_group_size;
+
     /* 
         The first line in a csv is the column names.
         Should follow:
@@ -74,15 +77,16 @@ int csv_groups(Group* groups, int number_of_groups, char filename[], int max_gro
     fprintf(file, "\n");
 
     /* Writing rows */
-    for (int i = 0; i < number_of_groups; i++) {
+    for (int i = 0; i < groups->number_of_groups; i++) {
         
         /* Write the group number and size*/
-        fprintf(file, "%d,%d,", i, groups[i].group_size);
+        fprintf(file, "%d,%d,", i, groups->group_size[i]);
 
         /* Write the members in the group */
+        int* members = &groups->members[i * max_group_size];
         for (int k=0;k<max_group_size;k++) {
-            if (k < groups[i].group_size) {
-                fprintf(file, "%d", groups[i].students[k]->student_id);
+            if (k < groups->group_size[i]) {
+                fprintf(file, "%d", roster->student_ids[members[k]]);
                 if (k < max_group_size-1) {
                     fprintf(file, ",");
                 }
@@ -97,72 +101,716 @@ int csv_groups(Group* groups, int number_of_groups, char filename[], int max_gro
 }
 
 /**
- * Create groups array from students
- * Return: groups array
+ * Allocates empty groups, all of the memory is a handful of contiguous blocks
+ * Return: groups pointer, NULL if allocation failed
  *
  * Inputs
- *  - students              Array of student struct
- *  - num_students          Size of the students argument
- *  - number_of_groups      Pointer to an int, places the number of groups into it 
+ *  - number_of_groups      The number of groups to make room for
+ *  - max_group_size        Largest number of students in a group
+ *  - num_students          The number of students that will be placed
  * Outputs
- *  - Saved groups in a csv file
+ *  - Newly allocated groups with no members, free with free_groups()
  * 
  */
-Group* create_initial_groups(Student* students, int num_students, int* number_of_groups, int max_group_size) {
-        
-    /* Allocate memory for the expected number of groups */
-    Group* groups = (Group*)malloc(sizeof(Group) * (num_students / max_group_size + max_group_size));
-
+Groups* allocate_groups(int number_of_groups, int max_group_size, int num_students) {
+    Groups* groups = (Groups*)malloc(sizeof(Groups));
     if (groups == NULL) {
         return NULL;
     }
 
-    groups[0].group_size = 0;
-    groups[0].happiness = -1; /* -1 means it hasn't been computed yet! */
+    groups->number_of_groups = number_of_groups;
+    groups->max_group_size = max_group_size;
+    groups->num_students = num_students;
+    groups->members = (int*)malloc(sizeof(int) * (number_of_groups * max_group_size + 1));
+    groups->group_size = (int*)calloc(number_of_groups + 1, sizeof(int));
+    groups->points = (int*)calloc(number_of_groups + 1, sizeof(int));
+    groups->happiness = (float*)malloc(sizeof(float) * (number_of_groups + 1));
+    groups->group_of = (int*)malloc(sizeof(int) * (num_students + 1));
+
+    if (groups->members == NULL || groups->group_size == NULL || groups->points == NULL || groups->happiness == NULL || groups->group_of == NULL) {
+        free_groups(groups);
+        return NULL;
+    }
+
+    /* -1 means it hasn't been computed yet! */
+    for (int i = 0; i < number_of_groups; i++) {
+        groups->happiness[i] = -1;
+    }
+
+    return groups;
+}
+
+/**
+ * Create groups from students
+ * Return: groups pointer, NULL if allocation failed
+ *
+ * Inputs
+ *  - roster                Dense students to place into groups
+ *  - max_group_size        Largest number of students in a group
+ * Outputs
+ *  - Groups filled in input order, every group is full except maybe the last
+ * 
+ */
+Groups* create_initial_groups(Roster* roster, int max_group_size) {
+
+    int num_students = roster->num_students;
+    int number_of_groups = (num_students + max_group_size - 1) / max_group_size;
+    if (number_of_groups < 1) {
+        number_of_groups = 1;
+    }
 
-    int current_group_idx = 0;
+    Groups* groups = allocate_groups(number_of_groups, max_group_size, num_students);
+    if (groups == NULL) {
+        return NULL;
+    }
 
     /* For each student, add them into the latest non-full group */
     for (int i = 0; i < num_students; i++) {
+        int current_group_idx = i / max_group_size;
+
+        groups->members[current_group_idx * max_group_size + groups->group_size[current_group_idx]] = i;
+        groups->group_size[current_group_idx]++;
+        groups->group_of[i] = current_group_idx;
+
+        if (DEBUG) {
+            printf("[DEBUG] Added student id: %d to group %d\n", roster->student_ids[i], current_group_idx);
+        }   
+    }
+
+    return groups;
+}
+
+/**
+ * Adds to the tally of every group holding a student linked to this one,
+ * a link is a preference of the student or a student that prefers them
+ * Return: void
+ *
+ * Inputs
+ *  - roster                Dense students
+ *  - groups                Partially filled groups, group_of is -1 when unplaced
+ *  - links                 Tally for each group
+ *  - student               Dense index of the student
+ *  - amount                Added per link, -1 undoes a tally
+ * Outputs
+ *  - Updated links
+ * 
+ */
+void tally_links(Roster* roster, Groups* groups, int* links, int student, int amount) {
+    int start = roster->listed_by_start[student];
+    int* lists[2] = {&roster->preferences[student * MAX_STUDENT_PREFERENCES], &roster->listed_by[start]};
+    int sizes[2] = {roster->preferences_size[student], roster->listed_by_start[student + 1] - start};
 
-        if (groups[current_group_idx].group_size == 0) {
-            groups[current_group_idx].students = (Student**)malloc(sizeof(Student**) * max_group_size);
+    for (int l = 0; l < 2; l++) {
+        for (int i = 0; i < sizes[l]; i++) {
+            int other = lists[l][i];
+            if (other >= 0 && groups->group_of[other] >= 0) {
+                links[groups->group_of[other]] += amount;
+            }
         }
-        
-        /* Check if the current group can handle another student */
-        if (groups[current_group_idx].group_size < max_group_size ) {
+    }
+}
 
+/**
+ * Finds the group a student is most linked to that still has room
+ * Return: int, the best group with at least need free places, -1 if no links
+ *
+ * Inputs
+ *  - roster                Dense students
+ *  - groups                Partially filled groups, group_of is -1 when unplaced
+ *  - capacity              Number of students each group will end up with
+ *  - links                 Scratch array of number_of_groups zeros, left zeroed
+ *  - student               Dense index of the student to place
+ *  - need                  Free places the group must have
+ * Outputs
+ *  - Group index with the most links, lowest index on ties
+ * 
+ */
+int most_linked_group(Roster* roster, Groups* groups, int* capacity, int* links, int student, int need) {
+    tally_links(roster, groups, links, student, 1);
 
+    int start = roster->listed_by_start[student];
+    int* lists[2] = {&roster->preferences[student * MAX_STUDENT_PREFERENCES], &roster->listed_by[start]};
+    int sizes[2] = {roster->preferences_size[student], roster->listed_by_start[student + 1] - start};
 
-            /* Add the student to the group */
-            groups[current_group_idx].students[groups[current_group_idx].group_size] = &students[i];
-            groups[current_group_idx].group_size++;
-        
-        } else {
-            
-            if (DEBUG) {
-                printf("[DEBUG] Allocating more memory for a new group\n");
+    int best_group = -1;
+    for (int l = 0; l < 2; l++) {
+        for (int i = 0; i < sizes[l]; i++) {
+            int other = lists[l][i];
+            if (other < 0 || groups->group_of[other] < 0) {
+                continue;
+            }
+
+            int group = groups->group_of[other];
+            if (capacity[group] - groups->group_size[group] < need) {
+                continue;
+            }
+
+            if (best_group == -1 || links[group] > links[best_group] || (links[group] == links[best_group] && group < best_group)) {
+                best_group = group;
             }
+        }
+    }
 
-            /* Allocate more memory for the next group */
-            current_group_idx++;
+    /* Clear the tally for the next student */
+    tally_links(roster, groups, links, student, -1);
+    return best_group;
+}
 
-            groups[current_group_idx].students = (Student**)malloc(sizeof(Student**) * max_group_size);
+/**
+ * Places a student in the group they are most linked to, or the first group
+ * with enough room if they aren't linked to any
+ * Return: void
+ *
+ * Inputs
+ *  - roster                Dense students
+ *  - groups                Partially filled groups
+ *  - capacity              Number of students each group will end up with
+ *  - links                 Scratch array of number_of_groups zeros
+ *  - next_open             First group that may still have room, moved past full groups
+ *  - student               Dense index of the student to place
+ *  - need                  Free places wanted, 2 keeps room for a mutual partner
+ * Outputs
+ *  - The student is added to groups and group_of
+ * 
+ */
+void place_student(Roster* roster, Groups* groups, int* capacity, int* links, int* next_open, int student, int need) {
+    int group = most_linked_group(roster, groups, capacity, links, student, need);
 
-            /* Add the student to the newly created group */
-            groups[current_group_idx].students[0] = &students[i];
-            groups[current_group_idx].group_size = 1;
-            groups[current_group_idx].happiness = -1;
+    if (group == -1) {
+        while (*next_open < groups->number_of_groups && groups->group_size[*next_open] >= capacity[*next_open]) {
+            *next_open += 1;
+        }
 
+        /* Look ahead for a group with enough room, settling for any room at all */
+        group = *next_open;
+        for (int i = *next_open; i < groups->number_of_groups; i++) {
+            if (capacity[i] - groups->group_size[i] >= need) {
+                group = i;
+                break;
+            }
         }
+    }
 
-        if (DEBUG) {
-            printf("[DEBUG] Added student id: %d to group %d\n", students[i].student_id, current_group_idx);
-        }   
+    groups->members[group * groups->max_group_size + groups->group_size[group]] = student;
+    groups->group_size[group]++;
+    groups->group_of[student] = group;
+}
+
+/**
+ * Places a student if they haven't been yet, then pulls their unplaced
+ * preferences in straight after while their group still has room
+ * Return: void
+ *
+ * Inputs
+ *  - roster                Dense students
+ *  - groups                Partially filled groups
+ *  - capacity              Number of students each group will end up with
+ *  - links                 Scratch array of number_of_groups zeros
+ *  - next_open             First group that may still have room
+ *  - student               Dense index of the student to place
+ * Outputs
+ *  - The student and their preferences are added to groups and group_of
+ * 
+ */
+void place_with_preferences(Roster* roster, Groups* groups, int* capacity, int* links, int* next_open, int student) {
+    if (groups->group_of[student] < 0) {
+        place_student(roster, groups, capacity, links, next_open, student, 1);
+    }
+
+    int* preferences = &roster->preferences[student * MAX_STUDENT_PREFERENCES];
+    for (int j = 0; j < roster->preferences_size[student]; j++) {
+        if (preferences[j] >= 0 && groups->group_of[preferences[j]] < 0) {
+            place_student(roster, groups, capacity, links, next_open, preferences[j], 1);
+        }
+    }
+}
+
+/**
+ * Orders students from most to least preferences (counting sort, stable)
+ * Return: void
+ *
+ * Inputs
+ *  - roster                Dense students
+ *  - order                 Filled with every dense index
+ * Outputs
+ *  - Ordered students
+ * 
+ */
+void order_by_preferences(Roster* roster, int* order) {
+    int size_count[MAX_STUDENT_PREFERENCES + 2] = {0};
+    for (int i = 0; i < roster->num_students; i++) {
+        size_count[MAX_STUDENT_PREFERENCES - roster->preferences_size[i] + 1]++;
+    }
+    for (int i = 1; i < MAX_STUDENT_PREFERENCES + 2; i++) {
+        size_count[i] += size_count[i - 1];
+    }
+    for (int i = 0; i < roster->num_students; i++) {
+        order[size_count[MAX_STUDENT_PREFERENCES - roster->preferences_size[i]]++] = i;
+    }
+}
+
+/**
+ * Create groups from students by following the preference graph, mutual
+ * pairs are placed first, then everyone else from most to least preferences,
+ * each followed by their own preferences.
+ * Each student joins the group holding most of their links with room to spare.
+ * Return: groups pointer, NULL if allocation failed
+ *
+ * Inputs
+ *  - roster                Dense students to place into groups
+ *  - max_group_size        Largest number of students in a group
+ * Outputs
+ *  - Groups with the same sizes as create_initial_groups()
+ * 
+ */
+Groups* create_greedy_groups(Roster* roster, int max_group_size) {
+
+    int num_students = roster->num_students;
+    int number_of_groups = (num_students + max_group_size - 1) / max_group_size;
+    if (number_of_groups < 1) {
+        number_of_groups = 1;
+    }
+
+    Groups* groups = allocate_groups(number_of_groups, max_group_size, num_students);
+    int* capacity = (int*)malloc(sizeof(int) * number_of_groups);
+    int* links = (int*)calloc(number_of_groups, sizeof(int));
+    int* order = (int*)malloc(sizeof(int) * (num_students + 1));
+
+    if (groups == NULL || capacity == NULL || links == NULL || order == NULL) {
+        free_groups(groups);
+        free(capacity);
+        free(links);
+        free(order);
+        return NULL;
+    }
+
+    /* Every group is full except maybe the last, same as filling in order */
+    for (int i = 0; i < number_of_groups; i++) {
+        capacity[i] = max_group_size;
+    }
+    capacity[number_of_groups - 1] = num_students - (number_of_groups - 1) * max_group_size;
+
+    for (int i = 0; i < num_students; i++) {
+        groups->group_of[i] = -1;
+    }
+
+    int next_open = 0;
+
+    /* Mutual pairs first, the first of a pair asks for room for the second */
+    for (int i = 0; i < num_students; i++) {
+        if (groups->group_of[i] >= 0) {
+            continue;
+        }
+
+        int* preferences = &roster->preferences[i * MAX_STUDENT_PREFERENCES];
+        for (int j = 0; j < roster->preferences_size[i]; j++) {
+            int other = preferences[j];
+            if (other < 0 || other == i || groups->group_of[other] >= 0) {
+                continue;
+            }
+
+            /* Check if the preference is returned */
+            int* other_preferences = &roster->preferences[other * MAX_STUDENT_PREFERENCES];
+            int mutual = 0;
+            for (int k = 0; k < roster->preferences_size[other]; k++) {
+                if (other_preferences[k] == i) {
+                    mutual = 1;
+                }
+            }
+
+            if (mutual) {
+                place_student(roster, groups, capacity, links, &next_open, i, 2);
+                place_student(roster, groups, capacity, links, &next_open, other, 1);
+                break;
+            }
+        }
+    }
+
+    /* Then everyone else, most preferences first */
+    order_by_preferences(roster, order);
+    for (int i = 0; i < num_students; i++) {
+        place_with_preferences(roster, groups, capacity, links, &next_open, order[i]);
+    }
+
+    if (DEBUG) {
+        for (int i = 0; i < num_students; i++) {
+            printf("[DEBUG] Added student id: %d to group %d\n", roster->student_ids[i], groups->group_of[i]);
+        }
+    }
+
+    free(capacity);
+    free(links);
+    free(order);
+    return groups;
+}
+
+/**
+ * Checks if a set of students can all join a group without breaking an
+ * apart constraint
+ * Return: int, 1 if they fit
+ *
+ * Inputs
+ *  - roster                Constrained dense students
+ *  - groups                Partially filled groups
+ *  - capacity              Number of students each group will end up with
+ *  - set                   Dense indices of the students
+ *  - count                 Number of students in set
+ *  - group                 Index of the group
+ * Outputs
+ *  - Whether the set fits
+ * 
+ */
+int fits_group(Roster* roster, Groups* groups, int* capacity, int* set, int count, int group) {
+    if (capacity[group] - groups->group_size[group] < count) {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int j = roster->apart_start[set[i]]; j < roster->apart_start[set[i] + 1]; j++) {
+            if (groups->group_of[roster->apart[j]] == group) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * Places a set of students in the group they are most linked to that they
+ * all fit in, or the first group they fit in if none of those do
+ * Return: int, 0 if they fit nowhere, 1 success
+ *
+ * Inputs
+ *  - roster                Constrained dense students
+ *  - groups                Partially filled groups
+ *  - capacity              Number of students each group will end up with
+ *  - links                 Scratch array of number_of_groups zeros, left zeroed
+ *  - next_open             First group that may still have room, moved past full groups
+ *  - set                   Dense indices of the students
+ *  - count                 Number of students in set
+ * Outputs
+ *  - The students are added to groups and group_of
+ * 
+ */
+int place_set(Roster* roster, Groups* groups, int* capacity, int* links, int* next_open, int* set, int count) {
+    for (int i = 0; i < count; i++) {
+        tally_links(roster, groups, links, set[i], 1);
+    }
+
+    int best_group = -1;
+    for (int i = 0; i < count; i++) {
+        int start = roster->listed_by_start[set[i]];
+        int* lists[2] = {&roster->preferences[set[i] * MAX_STUDENT_PREFERENCES], &roster->listed_by[start]};
+        int sizes[2] = {roster->preferences_size[set[i]], roster->listed_by_start[set[i] + 1] - start};
+
+        for (int l = 0; l < 2; l++) {
+            for (int j = 0; j < sizes[l]; j++) {
+                int other = lists[l][j];
+                if (other < 0 || groups->group_of[other] < 0) {
+                    continue;
+                }
+
+                int group = groups->group_of[other];
+                int better = best_group == -1 || links[group] > links[best_group] || (links[group] == links[best_group] && group < best_group);
+                if (better && fits_group(roster, groups, capacity, set, count, group)) {
+                    best_group = group;
+                }
+            }
+        }
+    }
+
+    /* Clear the tally for the next set */
+    for (int i = 0; i < count; i++) {
+        tally_links(roster, groups, links, set[i], -1);
+    }
+
+    if (best_group == -1) {
+        while (*next_open < groups->number_of_groups && groups->group_size[*next_open] >= capacity[*next_open]) {
+            *next_open += 1;
+        }
+
+        for (int i = *next_open; i < groups->number_of_groups; i++) {
+            if (fits_group(roster, groups, capacity, set, count, i)) {
+                best_group = i;
+                break;
+            }
+        }
+    }
+
+    if (best_group == -1) {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        groups->members[best_group * groups->max_group_size + groups->group_size[best_group]] = set[i];
+        groups->group_size[best_group]++;
+        groups->group_of[set[i]] = best_group;
+    }
+    return 1;
+}
+
+/**
+ * Create groups that meet every hard constraint. Must-be-together sets are
+ * placed whole first, largest first, then the students that must be apart
+ * from someone, then everyone else from most to least preferences, each
+ * followed by their own preferences. Every placement avoids the groups of
+ * anyone the student must be apart from.
+ * Return: groups pointer, NULL if allocation failed or a student couldn't be placed
+ *
+ * Inputs
+ *  - roster                Constrained dense students
+ *  - max_group_size        Largest number of students in a group
+ * Outputs
+ *  - Groups with the same sizes as create_initial_groups()
+ * 
+ */
+Groups* create_constrained_groups(Roster* roster, int max_group_size) {
+
+    int num_students = roster->num_students;
+    int number_of_groups = (num_students + max_group_size - 1) / max_group_size;
+    if (number_of_groups < 1) {
+        number_of_groups = 1;
+    }
+
+    Groups* groups = allocate_groups(number_of_groups, max_group_size, num_students);
+    int* capacity = (int*)malloc(sizeof(int) * number_of_groups);
+    int* links = (int*)calloc(number_of_groups, sizeof(int));
+    int* order = (int*)malloc(sizeof(int) * (num_students + 1));
+    int* set_start = (int*)calloc(num_students + 2, sizeof(int));
+    int* set_members = (int*)malloc(sizeof(int) * (num_students + 1));
+
+    if (groups == NULL || capacity == NULL || links == NULL || order == NULL || set_start == NULL || set_members == NULL) {
+        free_groups(groups);
+        free(capacity);
+        free(links);
+        free(order);
+        free(set_start);
+        free(set_members);
+        return NULL;
+    }
+
+    for (int i = 0; i < number_of_groups; i++) {
+        capacity[i] = max_group_size;
+    }
+    capacity[number_of_groups - 1] = num_students - (number_of_groups - 1) * max_group_size;
+
+    for (int i = 0; i < num_students; i++) {
+        groups->group_of[i] = -1;
+    }
+
+    /* Gather the members of each set by its first student (counting sort) */
+    for (int i = 0; i < num_students; i++) {
+        set_start[roster->together[i] + 1]++;
+    }
+    for (int i = 0; i < num_students; i++) {
+        set_start[i + 1] += set_start[i];
+    }
+    memcpy(order, set_start, sizeof(int) * num_students);
+    for (int i = 0; i < num_students; i++) {
+        set_members[order[roster->together[i]]++] = i;
+    }
+
+    int next_open = 0;
+    int placed = 1;
+
+    /* Largest sets first, while there is the most room to choose from */
+    for (int i = 0; i < num_students; i++) {
+        if (set_start[i + 1] - set_start[i] > max_group_size) {
+            printf("Student %d must be with more students than fit in a group\n", roster->student_ids[i]);
+            placed = 0;
+        }
+    }
+    for (int size = max_group_size; size >= 2 && placed; size--) {
+        for (int i = 0; i < num_students && placed; i++) {
+            if (set_start[i + 1] - set_start[i] == size) {
+                placed = place_set(roster, groups, capacity, links, &next_open, &set_members[set_start[i]], size);
+            }
+        }
+    }
+
+    /* Then the students that must be apart from someone, they have the fewest groups to choose from */
+    for (int i = 0; i < num_students && placed; i++) {
+        if (groups->group_of[i] < 0 && roster->apart_start[i + 1] > roster->apart_start[i]) {
+            placed = place_set(roster, groups, capacity, links, &next_open, &i, 1);
+        }
+    }
+
+    /* Then everyone else, most preferences first */
+    order_by_preferences(roster, order);
+    for (int i = 0; i < num_students && placed; i++) {
+        int student = order[i];
+        if (groups->group_of[student] < 0) {
+            placed = place_set(roster, groups, capacity, links, &next_open, &student, 1);
+        }
+
+        int* preferences = &roster->preferences[student * MAX_STUDENT_PREFERENCES];
+        for (int j = 0; j < roster->preferences_size[student] && placed; j++) {
+            if (preferences[j] >= 0 && groups->group_of[preferences[j]] < 0) {
+                placed = place_set(roster, groups, capacity, links, &next_open, &preferences[j], 1);
+            }
+        }
+    }
+
+    free(capacity);
+    free(links);
+    free(order);
+    free(set_start);
+    free(set_members);
+
+    if (!placed) {
+        printf("Could not place every student without breaking a constraint\n");
+        free_groups(groups);
+        return NULL;
+    }
+
+    if (DEBUG) {
+        for (int i = 0; i < num_students; i++) {
+            printf("[DEBUG] Added student id: %d to group %d\n", roster->student_ids[i], groups->group_of[i]);
+        }
     }
 
-    /* Convert index to size and return groups array */
-    *number_of_groups = current_group_idx + 1;
     return groups;
 }
 
+/**
+ * Create groups from students with the chosen initializer, constrained
+ * students always use create_constrained_groups()
+ * Return: groups pointer, NULL if allocation failed or the constraints couldn't be met
+ *
+ * Inputs
+ *  - roster                Dense students to place into groups
+ *  - max_group_size        Largest number of students in a group
+ *  - init                  INIT_ constant
+ * Outputs
+ *  - Groups for the solver to start from
+ * 
+ */
+Groups* create_groups(Roster* roster, int max_group_size, int init) {
+    if (roster->together != NULL) {
+        return create_constrained_groups(roster, max_group_size);
+    } else if (init == INIT_GREEDY) {
+        return create_greedy_groups(roster, max_group_size);
+    }
+    return create_initial_groups(roster, max_group_size);
+}
+
+/**
+ * Converts an initializer name from the command line to its constant
+ * Return: int, INIT_ constant or -1 if unknown
+ *
+ * Inputs
+ *   name       "sequential" or "greedy"
+ * Outputs
+ *  - Initializer constant
+ * 
+ */
+int parse_init(char* name) {
+    if (strcmp(name, "sequential") == 0) {
+        return INIT_SEQUENTIAL;
+    } else if (strcmp(name, "greedy") == 0) {
+        return INIT_GREEDY;
+    }
+    return -1;
+}
+
+/**
+ * Converts an initializer constant to a readable name
+ * Return: char*
+ *
+ * Inputs
+ *   init       INIT_ constant
+ * Outputs
+ *  - Name of the initializer
+ * 
+ */
+char* init_name(int init) {
+    if (init == INIT_GREEDY) {
+        return "greedy";
+    }
+    return "sequential";
+}
+
+/**
+ * Finds the average group happiness from the exact group points, rather
+ * than from the rounded happiness of each group
+ * Return: double
+ *
+ * Inputs
+ *  - groups                The groups, points must be up to date
+ * Outputs
+ *  - [0-1] Average group happiness
+ * 
+ */
+double average_happiness(Groups* groups) {
+    double sum = 0;
+    for (int i = 0; i < groups->number_of_groups; i++) {
+        if (groups->group_size[i] > 0) {
+            sum += groups->points[i] / (double) groups->group_size[i];
+        }
+    }
+    return sum / HAPPINESS_SCALE / groups->number_of_groups;
+}
+
+/**
+ * Allocates a copy of some groups
+ * Return: groups pointer, NULL if allocation failed
+ *
+ * Inputs
+ *  - groups                The groups to copy
+ * Outputs
+ *  - Newly allocated groups, free with free_groups()
+ * 
+ */
+Groups* copy_groups(Groups* groups) {
+    Groups* copy = allocate_groups(groups->number_of_groups, groups->max_group_size, groups->num_students);
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    copy_groups_into(copy, groups);
+    return copy;
+}
+
+/**
+ * Overwrites some groups with the contents of others of the same shape
+ * Return: void
+ *
+ * Inputs
+ *  - destination           The groups to write to
+ *  - source                The groups to read from
+ * Outputs
+ *  - destination matches source
+ * 
+ */
+void copy_groups_into(Groups* destination, Groups* source) {
+    int number_of_groups = source->number_of_groups;
+
+    memcpy(destination->members, source->members, sizeof(int) * number_of_groups * source->max_group_size);
+    memcpy(destination->group_size, source->group_size, sizeof(int) * number_of_groups);
+    memcpy(destination->points, source->points, sizeof(int) * number_of_groups);
+    memcpy(destination->happiness, source->happiness, sizeof(float) * number_of_groups);
+    memcpy(destination->group_of, source->group_of, sizeof(int) * source->num_students);
+}
+
+/**
+ * Frees groups and all of their arrays
+ * Return: void
+ *
+ * Inputs
+ *  - groups                The groups to free, can be NULL
+ * Outputs
+ *  - Deallocated memory
+ * 
+ */
+void free_groups(Groups* groups) {
+    if (groups == NULL) {
+        return;
+    }
+
+    free(groups->members);
+    free(groups->group_size);
+    free(groups->points);
+    free(groups->happiness);
+    free(groups->group_of);
+    free(groups);
+}
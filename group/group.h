@@ -3,8 +3,23 @@
 
 #include "../global/global.h" /* standard libraries, consts, structs */
 
-Group* create_initial_groups(Student* students, int num_students, int* number_of_groups, int max_group_size);
-void stdout_groups(Group* groups, int number_of_groups);
-int csv_groups(Group* groups, int number_of_groups, char filename[], int max_group_size);
+Groups* allocate_groups(int number_of_groups, int max_group_size, int num_students);
+Groups* create_initial_groups(Roster* roster, int max_group_size);
+void order_by_preferences(Roster* roster, int* order);
+Groups* create_greedy_groups(Roster* roster, int max_group_size);
+int fits_group(Roster* roster, Groups* groups, int* capacity, int* set, int count, int group);
+int place_set(Roster* roster, Groups* groups, int* capacity, int* links, int* next_open, int* set, int count);
+Groups* create_constrained_groups(Roster* roster, int max_group_size);
+void place_student(Roster* roster, Groups* groups, int* capacity, int* links, int* next_open, int student, int need);
+void place_with_preferences(Roster* roster, Groups* groups, int* capacity, int* links, int* next_open, int student);
+Groups* create_groups(Roster* roster, int max_group_size, int init);
+int parse_init(char* name);
+char* init_name(int init);
+void stdout_groups(Groups* groups, Roster* roster);
+int csv_groups(Groups* groups, Roster* roster, char filename[]);
+double average_happiness(Groups* groups);
+Groups* copy_groups(Groups* groups);
+void copy_groups_into(Groups* destination, Groups* source);
+void free_groups(Groups* groups);
 
 #endif
\ No newline at end of file
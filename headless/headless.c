@@ -9,9 +9,11 @@
 
 #include "headless.h"
 
-#include "../student/student.h"     /* load_students_from_csv display_students*/
-#include "../group/group.h"         /*create_initial_groups csv_groups*/
+#include "../student/student.h"     /* load_students_from_csv display_students build_roster constrain_roster free_roster*/
+#include "../group/group.h"         /*create_initial_groups csv_groups free_groups*/
 #include "../solver/solver.h"       /*solve*/
+#include "../components/components.h" /*solve_components*/
+#include "../island/island.h"         /*solve_islands*/
 
 /*******************************************************************************
  * Global variables
@@ -19,7 +21,7 @@
 
 extern int DEBUG;
 
-int headless_mode(char* arg_input_file, char * arg_output_file, int max_group_size) { 
+int headless_mode(char* arg_input_file, char * arg_output_file, int max_group_size, SolverConfig* config) { 
 
     /* Load student preferences */ 
     Student* new_students = (Student*)malloc(sizeof(Student) * 0);
@@ -42,61 +44,71 @@ int headless_mode(char* arg_input_file, char * arg_output_file, int max_group_si
 
     if (DEBUG) {display_students(new_students, num_students);}
 
-    /* Convert the students into groups */
-    int number_of_groups;
-    Group* groups = create_initial_groups(new_students, num_students, &number_of_groups, max_group_size);
+    /* Remap the student ids to dense indices for the solver */
+    Roster* roster = build_roster(new_students, num_students);
+    free(new_students);
 
-    if (number_of_groups < 2) {
-        printf("Group size too small, nothing to do...\n");
+    if (roster == NULL) {
+        printf("Could not index students\n");
         return 1;
     }
 
-    if (number_of_groups < 2) {
-        printf("Group size too small, nothing to do...\n");
+    /* Add the hard constraints */
+    if (config->constraints != NULL && !constrain_roster(roster, config->constraints)) {
+        free_roster(roster);
         return 1;
     }
 
+    /* Convert the students into groups */
+    Groups* groups = create_groups(roster, max_group_size, config->init);
+
     /* Make sure that groups was allocated correctly */
     if (groups == NULL) {
-        free(new_students);
+        free_roster(roster);
         printf("Could not create groups\n");
         return 1;
     }
 
+    if (groups->number_of_groups < 2) {
+        free_roster(roster);
+        free_groups(groups);
+        printf("Group size too small, nothing to do...\n");
+        return 1;
+    }
+
     /* Solve the groups */
-    int solved = solve(groups, number_of_groups, 3, 0.00005, max_group_size);
+    SolverReport report;
+    int solved;
+    if (config->decompose) {
+        solved = solve_components(roster, &groups, config, &report);
+    } else if (config->islands > 0) {
+        solved = solve_islands(roster, groups, config, &report);
+    } else {
+        solved = solve(roster, groups, config, &report);
+    }
 
     /* Check if the solver worked */
     if (solved != 1){
-        free(new_students);
-        for (int current_group_idx=0; current_group_idx<number_of_groups; current_group_idx++) {
-            free(groups[current_group_idx].students);
-        }
-        free(groups);
+        free_roster(roster);
+        free_groups(groups);
         
         printf("Could not solve\n");
         return 1;
     }
 
     /* Save the results */
-    int success = csv_groups(groups, number_of_groups, arg_output_file, max_group_size);
+    int success = csv_groups(groups, roster, arg_output_file);
 
     /* Check if we could save */
     if (success == 0) {
-        free(new_students);
-        for (int current_group_idx=0; current_group_idx<number_of_groups; current_group_idx++) {
-            free(groups[current_group_idx].students);
-        }
-        free(groups);
+        free_roster(roster);
+        free_groups(groups);
         printf("Could not save\n");
         return 1;
     }
     
     /* Free and exit */
-    free(new_students);
-    for (int current_group_idx=0; current_group_idx<number_of_groups; current_group_idx++) {
-        free(groups[current_group_idx].students);
-    }
-    free(groups);
+    free_roster(roster);
+    free_groups(groups);
     return 0;
 }
\ No newline at end of file
@@ -3,6 +3,6 @@
 
 #include "../global/global.h" /* standard libraries, consts, structs */
 
-int headless_mode(char* arg_input_file, char * arg_output_file, int max_group_size);
+int headless_mode(char* arg_input_file, char * arg_output_file, int max_group_size, SolverConfig* config);
 
 #endif
\ No newline at end of file
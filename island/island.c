@@ -0,0 +1,427 @@
+/*******************************************************************************
+ * island.c
+ * Solves in several worker processes at once, each on its own copy of the
+ * groups. Every so often they publish their groups to a shared memory
+ * segment, and the islands falling behind carry on from the best ones
+*******************************************************************************/
+
+/*******************************************************************************
+ * Function prototypes
+*******************************************************************************/
+
+#include "island.h"
+
+#include <errno.h>      /* EOWNERDEAD */
+#include <fcntl.h>      /* O_CREAT O_EXCL O_RDWR */
+#include <pthread.h>    /* pthread_mutex_t, process shared and robust */
+#include <sys/mman.h>   /* shm_open shm_unlink mmap munmap */
+#include <sys/wait.h>   /* waitpid */
+#include <unistd.h>     /* fork ftruncate getpid _exit */
+
+#include "../solver/solver.h" /* solve set_group_happiness size_weight groups_score */
+#include "../group/group.h"   /* average_happiness */
+#include "../utils/utils.h"   /* time_ms */
+
+/*******************************************************************************
+ * Global variables
+*******************************************************************************/
+
+extern int DEBUG;
+
+/*
+    Constants
+*/
+#define ISLAND_ALIGN    64      /* Bytes each slot is aligned to, so islands don't share cache lines */
+
+/* Start of the shared memory, followed by a slot for each island */
+typedef struct IslandSegment {
+    int islands;
+    int number_of_groups;
+    int max_group_size;
+    int num_students;
+    size_t stride;          /* Bytes from one slot to the next */
+} IslandSegment;
+
+/*
+    What an island has published, followed by its groups as
+    members, group_size and group_of, laid out like in Groups
+*/
+typedef struct {
+    pthread_mutex_t lock;   /* Process shared and robust, a worker dying while holding it doesn't block the rest */
+    volatile int writing;   /* 1 while the owner is publishing, the groups are only half written if it dies then */
+    long long score;        /* Exact score of the published groups, see group_score(), -1 if there are none */
+    int finished;           /* 1 once the island's solve returned */
+    SolverReport report;    /* How the island's run went, once finished */
+} IslandSlot;
+
+/**
+ * Finds the slot of an island
+ * Return: IslandSlot pointer
+ *
+ * Inputs
+ *  - segment       The shared segment
+ *  - island        Index of the island
+ * Outputs
+ *  - The island's slot
+ *
+ */
+IslandSlot* island_slot(IslandSegment* segment, int island) {
+    size_t header = (sizeof(IslandSegment) + ISLAND_ALIGN - 1) / ISLAND_ALIGN * ISLAND_ALIGN;
+    return (IslandSlot*)((char*)segment + header + segment->stride * island);
+}
+
+/**
+ * Locks a slot. If the island holding it died while publishing, the slot's
+ * groups are half written, so they are thrown away. Dying while only
+ * reading it leaves them intact
+ * Return: int, 0 fail, 1 success
+ *
+ * Inputs
+ *  - slot          The slot to lock
+ * Outputs
+ *  - Locked slot
+ *
+ */
+int lock_slot(IslandSlot* slot) {
+    int result = pthread_mutex_lock(&slot->lock);
+    if (result == EOWNERDEAD) {
+        if (slot->writing) {
+            slot->score = -1;
+            slot->writing = 0;
+        }
+        pthread_mutex_consistent(&slot->lock);
+        return 1;
+    }
+    return result == 0;
+}
+
+/**
+ * Copies groups into a slot
+ * Return: void
+ *
+ * Inputs
+ *  - segment       The shared segment
+ *  - slot          Locked slot to write to
+ *  - groups        The groups to publish
+ *  - score         Exact score of the groups
+ * Outputs
+ *  - Published groups
+ *
+ */
+void publish_groups(IslandSegment* segment, IslandSlot* slot, Groups* groups, long long score) {
+    int* members = (int*)(slot + 1);
+    int* group_size = members + segment->number_of_groups * segment->max_group_size;
+    int* group_of = group_size + segment->number_of_groups;
+
+    slot->writing = 1;
+    memcpy(members, groups->members, sizeof(int) * groups->number_of_groups * groups->max_group_size);
+    memcpy(group_size, groups->group_size, sizeof(int) * groups->number_of_groups);
+    memcpy(group_of, groups->group_of, sizeof(int) * groups->num_students);
+    slot->score = score;
+    slot->writing = 0;
+}
+
+/**
+ * Copies the groups of a slot over some groups, the points of every group
+ * have to be worked out again afterwards
+ * Return: void
+ *
+ * Inputs
+ *  - segment       The shared segment
+ *  - slot          Locked slot to read from
+ *  - groups        The groups to overwrite
+ * Outputs
+ *  - Adopted groups
+ *
+ */
+void adopt_groups(IslandSegment* segment, IslandSlot* slot, Groups* groups) {
+    int* members = (int*)(slot + 1);
+    int* group_size = members + segment->number_of_groups * segment->max_group_size;
+    int* group_of = group_size + segment->number_of_groups;
+
+    memcpy(groups->members, members, sizeof(int) * groups->number_of_groups * groups->max_group_size);
+    memcpy(groups->group_size, group_size, sizeof(int) * groups->number_of_groups);
+    memcpy(groups->group_of, group_of, sizeof(int) * groups->num_students);
+}
+
+/**
+ * Publishes an island's groups if they improved, then takes the best
+ * island's groups when this one ranks in the worse half, or when the best
+ * already reached the bound
+ * Return: int, 1 if the groups were replaced, 0 otherwise
+ *
+ * Inputs
+ *  - segment       The shared segment
+ *  - island        Index of this island
+ *  - groups        The island's current groups
+ *  - score         Exact score of the groups
+ *  - bound_score   Score no grouping can beat, -1 if it isn't exact
+ * Outputs
+ *  - Published groups, maybe replaced groups
+ *
+ */
+int migrate_island(IslandSegment* segment, int island, Groups* groups, long long score, long long bound_score) {
+    IslandSlot* own = island_slot(segment, island);
+    if (lock_slot(own)) {
+        if (score > own->score) {
+            publish_groups(segment, own, groups, score);
+        }
+        pthread_mutex_unlock(&own->lock);
+    }
+
+    /* Rank against the other islands */
+    int better = 0;
+    int best = -1;
+    long long best_score = score;
+    for (int i = 0; i < segment->islands; i++) {
+        IslandSlot* slot = island_slot(segment, i);
+        if (i == island || !lock_slot(slot)) {
+            continue;
+        }
+        long long published = slot->score;
+        pthread_mutex_unlock(&slot->lock);
+
+        if (published > score) {
+            better++;
+        }
+        if (published > best_score) {
+            best = i;
+            best_score = published;
+        }
+    }
+
+    int behind = better >= segment->islands / 2 || (bound_score >= 0 && best_score >= bound_score);
+    if (best == -1 || !behind) {
+        return 0;
+    }
+
+    /* It may have been thrown away since */
+    IslandSlot* slot = island_slot(segment, best);
+    int adopted = 0;
+    if (lock_slot(slot)) {
+        if (slot->score > score) {
+            adopt_groups(segment, slot, groups);
+            adopted = 1;
+        }
+        pthread_mutex_unlock(&slot->lock);
+    }
+
+    if (adopted && DEBUG) {
+        printf("[DEBUG] Island %d adopted the groups of island %d\n", island, best);
+    }
+    return adopted;
+}
+
+/**
+ * Creates the shared memory segment, the name is removed straight away so
+ * it goes away with the last process using it
+ * Return: IslandSegment pointer, NULL if it couldn't be created
+ *
+ * Inputs
+ *  - islands       Number of islands
+ *  - groups        Groups the islands start from
+ *  - size          Set to the number of bytes mapped
+ * Outputs
+ *  - Mapped segment with an empty slot for each island, free with munmap()
+ *
+ */
+IslandSegment* create_segment(int islands, Groups* groups, size_t* size) {
+    size_t groups_bytes = sizeof(int) * ((size_t)groups->number_of_groups * groups->max_group_size + groups->number_of_groups + groups->num_students);
+    size_t stride = (sizeof(IslandSlot) + groups_bytes + ISLAND_ALIGN - 1) / ISLAND_ALIGN * ISLAND_ALIGN;
+    size_t header = (sizeof(IslandSegment) + ISLAND_ALIGN - 1) / ISLAND_ALIGN * ISLAND_ALIGN;
+    *size = header + stride * islands;
+
+    char name[64];
+    sprintf(name, "/uniunity-islands-%ld", (long)getpid());
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        return NULL;
+    }
+    shm_unlink(name);
+
+    if (ftruncate(fd, *size) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+
+    IslandSegment* segment = (IslandSegment*)memory;
+    segment->islands = islands;
+    segment->number_of_groups = groups->number_of_groups;
+    segment->max_group_size = groups->max_group_size;
+    segment->num_students = groups->num_students;
+    segment->stride = stride;
+
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+
+    for (int i = 0; i < islands; i++) {
+        IslandSlot* slot = island_slot(segment, i);
+        pthread_mutex_init(&slot->lock, &attributes);
+        slot->writing = 0;
+        slot->score = -1;
+        slot->finished = 0;
+    }
+    pthread_mutexattr_destroy(&attributes);
+
+    return segment;
+}
+
+/**
+ * Runs one island in a freshly forked worker process and exits it. Only the
+ * first island checkpoints, resumes and traces
+ * Return: void, never returns
+ *
+ * Inputs
+ *  - roster        Dense students
+ *  - groups        The worker's copy of the starting groups
+ *  - config        Solver parameters
+ *  - segment       The shared segment
+ *  - island        Index of this island
+ * Outputs
+ *  - Final groups and report in the island's slot, exit status 0 if it solved
+ *
+ */
+void run_island(Roster* roster, Groups* groups, SolverConfig* config, IslandSegment* segment, int island) {
+    SolverConfig island_config = *config;
+    island_config.seed = config->seed + island;
+    island_config.island_segment = segment;
+    island_config.island = island;
+    if (island > 0) {
+        island_config.checkpoint = NULL;
+        island_config.resume = NULL;
+        island_config.trace = NULL;
+    }
+
+    SolverReport island_report;
+    int solved = solve(roster, groups, &island_config, &island_report);
+
+    IslandSlot* slot = island_slot(segment, island);
+    if (solved && lock_slot(slot)) {
+        long long score = groups_score(groups, size_weight(groups->max_group_size));
+        if (score >= slot->score) {
+            publish_groups(segment, slot, groups, score);
+        }
+        slot->report = island_report;
+        slot->finished = 1;
+        pthread_mutex_unlock(&slot->lock);
+    }
+
+    fflush(stdout);
+    _exit(solved ? 0 : 1);
+}
+
+/**
+ * Solves on several islands, each a forked worker process running solve()
+ * on its own copy of the groups with its own seed. They trade groups every
+ * config->migration_interval iterations, see migrate_island(). A worker
+ * that crashes only loses its own run, the best groups published by any
+ * island are kept
+ * Return: int, 0 fail, 1 success
+ *
+ * Inputs
+ *   roster             Dense students
+ *   groups             The groups to improve
+ *   config             Solver parameters, config->islands workers are started
+ *   report             Filled in with how the run went, summed over the islands, can be NULL
+ * Outputs
+ *  - Best groups found, success state
+ *
+ */
+int solve_islands(Roster* roster, Groups* groups, SolverConfig* config, SolverReport* report) {
+    double start_time = time_ms();
+    int islands = config->islands;
+
+    size_t size;
+    IslandSegment* segment = create_segment(islands, groups, &size);
+    pid_t* workers = (pid_t*)malloc(sizeof(pid_t) * islands);
+    if (segment == NULL || workers == NULL) {
+        if (segment != NULL) {
+            munmap(segment, size);
+        }
+        free(workers);
+        printf("Could not create the shared memory for the islands\n");
+        return 0;
+    }
+
+    /* Anything still buffered would be printed again by every worker */
+    fflush(stdout);
+
+    for (int i = 0; i < islands; i++) {
+        workers[i] = fork();
+        if (workers[i] == 0) {
+            free(workers);
+            run_island(roster, groups, config, segment, i);
+        } else if (workers[i] == -1) {
+            printf("Could not start island %d\n", i);
+        }
+    }
+
+    for (int i = 0; i < islands; i++) {
+        int status;
+        if (workers[i] == -1 || waitpid(workers[i], &status, 0) == -1) {
+            continue;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("Island %d stopped unexpectedly, keeping what it published\n", i);
+        }
+    }
+    free(workers);
+
+    /* Keep the best published groups */
+    int best = -1;
+    long long best_score = -1;
+    long long iterations = 0;
+    long long accepted = 0;
+    for (int i = 0; i < islands; i++) {
+        IslandSlot* slot = island_slot(segment, i);
+        if (!lock_slot(slot)) {
+            continue;
+        }
+        if (slot->score > best_score) {
+            best = i;
+            best_score = slot->score;
+        }
+        if (slot->finished) {
+            iterations += slot->report.iterations;
+            accepted += slot->report.accepted;
+        }
+        pthread_mutex_unlock(&slot->lock);
+    }
+
+    if (best == -1) {
+        munmap(segment, size);
+        return 0;
+    }
+
+    IslandSlot* slot = island_slot(segment, best);
+    adopt_groups(segment, slot, groups);
+    for (int i = 0; i < groups->number_of_groups; i++) {
+        set_group_happiness(roster, groups, i);
+    }
+
+    if (report != NULL) {
+        report->iterations = iterations;
+        report->accepted = accepted;
+        report->stop_reason = slot->finished ? slot->report.stop_reason : STOP_ITERATIONS;
+        report->elapsed = time_ms() - start_time;
+        report->refine_elapsed = slot->finished ? slot->report.refine_elapsed : 0;
+        report->score = average_happiness(groups);
+        report->bound = slot->finished ? slot->report.bound : 1;
+    }
+
+    if (DEBUG) {
+        printf("[DEBUG] Kept the groups of island %d out of %d (%.0f ms)\n", best, islands, time_ms() - start_time);
+    }
+
+    munmap(segment, size);
+    return 1;
+}
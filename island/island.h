@@ -0,0 +1,9 @@
+#ifndef ISLAND_H
+#define ISLAND_H
+
+#include "../global/global.h" /* standard libraries, consts, structs */
+
+int migrate_island(struct IslandSegment* segment, int island, Groups* groups, long long score, long long bound_score);
+int solve_islands(Roster* roster, Groups* groups, SolverConfig* config, SolverReport* report);
+
+#endif
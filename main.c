@@ -12,6 +12,8 @@
 #include "global/global.h"      /* standard libraries, consts, structs */
 #include "menu/menu.h"          /* option_handler */
 #include "headless/headless.h"  /* headless_mode */
+#include "solver/solver.h"      /* default_solver_config parse_schedule parse_strategy parse_moves */
+#include "group/group.h"        /* parse_init */
 
 /*******************************************************************************
  * Function prototypes
@@ -43,6 +45,26 @@ int main(int argc, char* argv[]) {
     char arg_input[8] = "-i";
     char arg_output[8] = "-o";
     char arg_groups[8] = "-g";
+    char arg_threads[8] = "-t";
+    char arg_seed[8] = "--seed";
+    char arg_schedule[16] = "--schedule";
+    char arg_temperature[16] = "--temperature";
+    char arg_time_limit[16] = "--time-limit";
+    char arg_stall[16] = "--stall";
+    char arg_init[8] = "--init";
+    char arg_strategy[16] = "--strategy";
+    char arg_directed[16] = "--directed";
+    char arg_moves[8] = "--moves";
+    char arg_no_refine[16] = "--no-refine";
+    char arg_checkpoint[16] = "--checkpoint";
+    char arg_checkpoint_interval[32] = "--checkpoint-interval";
+    char arg_resume[16] = "--resume";
+    char arg_constraints[16] = "--constraints";
+    char arg_trace[8] = "--trace";
+    char arg_trace_interval[32] = "--trace-interval";
+    char arg_decompose[16] = "--decompose";
+    char arg_islands[16] = "--islands";
+    char arg_migrate[16] = "--migrate";
     char arg_help[8] = "--help";
 
     char * arg_input_file;
@@ -60,19 +82,43 @@ int main(int argc, char* argv[]) {
     /* size of groups in headless mode */
     int size_of_groups = 5;
 
+    /* Solver parameters, shared by headless and menu mode */
+    SolverConfig config;
+    default_solver_config(&config);
+
     /* Process the provided arguments */
     int i;
     for (i = 1; i < argc; i++) {
         
         /* Help menu */
         if (strcmp(argv[i], arg_help) == 0) {
-            printf("usage: main [--help] [-d] ([-i] input_file [-o] output_file ([-g] max_group_size))\n");
+            printf("usage: main [--help] [-d] [-t threads] [--seed seed] [--schedule name] [--temperature t] [--time-limit ms] [--stall n] [--init name] [--strategy name] [--directed f] [--moves list] [--no-refine] [--checkpoint file] [--checkpoint-interval ms] [--resume file] [--constraints file] [--trace file] [--trace-interval ms] [--decompose] [--islands n] [--migrate n] ([-i] input_file [-o] output_file ([-g] max_group_size))\n");
             printf("optional arguments:\n");
             printf("--help      show this help message and exit\n");
             printf("-d          debug mode, shows additional data\n");
             printf("-i          input csv of student preferences\n");
             printf("-o          output csv of solved groups\n");
             printf("-g          maximum size of groups in solution\n");
+            printf("-t          number of solver threads, the best result is kept\n");
+            printf("--seed      seed for the random numbers, reuse it to reproduce a run\n");
+            printf("--schedule  rule for keeping bad swaps: fixed, geometric or adaptive\n");
+            printf("--temperature  starting temperature of the geometric/adaptive schedules\n");
+            printf("--time-limit   solve for this many milliseconds instead of guessing from confidence\n");
+            printf("--stall     stop after this many kept swaps without any improvement\n");
+            printf("--init      how the starting groups are built: sequential or greedy\n");
+            printf("--strategy  how the solver searches: swap, genetic, lns or tabu\n");
+            printf("--directed  fraction of swaps aimed at unmet preferences, 0 to 1\n");
+            printf("--moves     comma separated moves to use: swap, relocate, rotate, default swap\n");
+            printf("--no-refine skip the final pass that refines linked pairs of groups\n");
+            printf("--checkpoint   save the solver state to this file every so often\n");
+            printf("--checkpoint-interval  milliseconds between checkpoints, default 60000\n");
+            printf("--resume    continue from a checkpoint made with the same input and parameters\n");
+            printf("--constraints  csv of student pairs that must be together or apart: id,id,together|apart\n");
+            printf("--trace     sample the solver's speed, acceptance and score to a csv, or json lines if it ends in .jsonl\n");
+            printf("--trace-interval  milliseconds between trace samples, default 1000\n");
+            printf("--decompose solve each group of students that only list each other on its own, in parallel\n");
+            printf("--islands   solve in this many worker processes that trade their best groups\n");
+            printf("--migrate   iterations between islands trading groups, default 100000\n");
             return 1;
         
         /* Set global debug to true */
@@ -118,12 +164,299 @@ int main(int argc, char* argv[]) {
 
             i = i+1;
 
+        /* Number of solver threads declared */
+        } else if (strcmp(argv[i], arg_threads) == 0) {
+            if (i+1 < argc) {
+                config.threads = atoi(argv[i+1]);
+            } else {
+                printf("No value for threads provided\n");
+                return 1;
+            }
+
+            if (config.threads < 1) {
+                printf("Invalid number of threads, must be at least 1\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Random seed declared */
+        } else if (strcmp(argv[i], arg_seed) == 0) {
+            if (i+1 < argc) {
+                char* end;
+                config.seed = strtoull(argv[i+1], &end, 10);
+                if (*end != '\0' || end == argv[i+1]) {
+                    printf("Invalid seed, must be a positive whole number\n");
+                    return 1;
+                }
+            } else {
+                printf("No value for seed provided\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Solver schedule declared */
+        } else if (strcmp(argv[i], arg_schedule) == 0) {
+            if (i+1 < argc) {
+                config.schedule = parse_schedule(argv[i+1]);
+            } else {
+                printf("No value for schedule provided\n");
+                return 1;
+            }
+
+            if (config.schedule == -1) {
+                printf("Unknown schedule, must be fixed, geometric or adaptive\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Starting temperature declared */
+        } else if (strcmp(argv[i], arg_temperature) == 0) {
+            if (i+1 < argc) {
+                config.temperature = atof(argv[i+1]);
+            } else {
+                printf("No value for temperature provided\n");
+                return 1;
+            }
+
+            if (config.temperature <= 0) {
+                printf("Invalid temperature, must be larger than 0\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Time limit declared */
+        } else if (strcmp(argv[i], arg_time_limit) == 0) {
+            if (i+1 < argc) {
+                config.time_limit = atoi(argv[i+1]);
+            } else {
+                printf("No value for time limit provided\n");
+                return 1;
+            }
+
+            if (config.time_limit < 1) {
+                printf("Invalid time limit, must be at least 1 millisecond\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Stall limit declared */
+        } else if (strcmp(argv[i], arg_stall) == 0) {
+            if (i+1 < argc) {
+                config.stall_limit = atoi(argv[i+1]);
+            } else {
+                printf("No value for stall limit provided\n");
+                return 1;
+            }
+
+            if (config.stall_limit < 1) {
+                printf("Invalid stall limit, must be at least 1\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Initializer declared */
+        } else if (strcmp(argv[i], arg_init) == 0) {
+            if (i+1 < argc) {
+                config.init = parse_init(argv[i+1]);
+            } else {
+                printf("No value for initializer provided\n");
+                return 1;
+            }
+
+            if (config.init == -1) {
+                printf("Unknown initializer, must be sequential or greedy\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Solver strategy declared */
+        } else if (strcmp(argv[i], arg_strategy) == 0) {
+            if (i+1 < argc) {
+                config.strategy = parse_strategy(argv[i+1]);
+            } else {
+                printf("No value for strategy provided\n");
+                return 1;
+            }
+
+            if (config.strategy == -1) {
+                printf("Unknown strategy, must be swap, genetic, lns or tabu\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Fraction of directed swaps declared */
+        } else if (strcmp(argv[i], arg_directed) == 0) {
+            if (i+1 < argc) {
+                config.directed = atof(argv[i+1]);
+            } else {
+                printf("No value for directed fraction provided\n");
+                return 1;
+            }
+
+            if (config.directed < 0 || config.directed > 1) {
+                printf("Invalid directed fraction, must be between 0 and 1\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Solver moves declared */
+        } else if (strcmp(argv[i], arg_moves) == 0) {
+            if (i+1 < argc) {
+                config.moves = parse_moves(argv[i+1]);
+            } else {
+                printf("No value for moves provided\n");
+                return 1;
+            }
+
+            if (config.moves == -1) {
+                printf("Unknown moves, must be a comma separated list of swap, relocate and rotate\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Skip the refinement pass */
+        } else if (strcmp(argv[i], arg_no_refine) == 0) {
+            config.refine = 0;
+
+        /* Checkpoint file declared */
+        } else if (strcmp(argv[i], arg_checkpoint) == 0) {
+            if (i+1 < argc) {
+                config.checkpoint = argv[i+1];
+            } else {
+                printf("No value for checkpoint file provided\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Checkpoint interval declared */
+        } else if (strcmp(argv[i], arg_checkpoint_interval) == 0) {
+            if (i+1 < argc) {
+                config.checkpoint_interval = atoi(argv[i+1]);
+            } else {
+                printf("No value for checkpoint interval provided\n");
+                return 1;
+            }
+
+            if (config.checkpoint_interval < 1) {
+                printf("Invalid checkpoint interval, must be at least 1 millisecond\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Checkpoint to resume from declared */
+        } else if (strcmp(argv[i], arg_resume) == 0) {
+            if (i+1 < argc) {
+                config.resume = argv[i+1];
+            } else {
+                printf("No value for resume file provided\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Constraints file declared */
+        } else if (strcmp(argv[i], arg_constraints) == 0) {
+            if (i+1 < argc) {
+                config.constraints = argv[i+1];
+            } else {
+                printf("No value for constraints file provided\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Trace file declared */
+        } else if (strcmp(argv[i], arg_trace) == 0) {
+            if (i+1 < argc) {
+                config.trace = argv[i+1];
+            } else {
+                printf("No value for trace file provided\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Trace interval declared */
+        } else if (strcmp(argv[i], arg_trace_interval) == 0) {
+            if (i+1 < argc) {
+                config.trace_interval = atoi(argv[i+1]);
+            } else {
+                printf("No value for trace interval provided\n");
+                return 1;
+            }
+
+            if (config.trace_interval < 1) {
+                printf("Invalid trace interval, must be at least 1 millisecond\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Solve the components of the preference graph separately */
+        } else if (strcmp(argv[i], arg_decompose) == 0) {
+            config.decompose = 1;
+
+        /* Number of island processes declared */
+        } else if (strcmp(argv[i], arg_islands) == 0) {
+            if (i+1 < argc) {
+                config.islands = atoi(argv[i+1]);
+            } else {
+                printf("No value for islands provided\n");
+                return 1;
+            }
+
+            if (config.islands < 2) {
+                printf("Invalid number of islands, must be at least 2\n");
+                return 1;
+            }
+
+            i = i+1;
+
+        /* Migration interval declared */
+        } else if (strcmp(argv[i], arg_migrate) == 0) {
+            if (i+1 < argc) {
+                config.migration_interval = atoi(argv[i+1]);
+            } else {
+                printf("No value for migration interval provided\n");
+                return 1;
+            }
+
+            if (config.migration_interval < 1) {
+                printf("Invalid migration interval, must be at least 1 iteration\n");
+                return 1;
+            }
+
+            i = i+1;
+
         } else {
             printf("Unknown argument: %s\n", argv[i]);
             return 1;
         }
     }
 
+    /* A resumed run keeps saving to the checkpoint it came from */
+    if (config.resume != NULL && config.checkpoint == NULL) {
+        config.checkpoint = config.resume;
+    }
+
+    /* Islands each solve the whole cohort, components are solved in one process */
+    if (config.islands > 0 && config.decompose) {
+        printf("Invalid arguments, --islands and --decompose can't be used together\n");
+        return 1;
+    }
+
     /* Check if both "headless" values were provided */
     if (headless == 1) {
         printf("Invalid arguments, need both -i and -o to be defined\n");
@@ -131,8 +464,8 @@ int main(int argc, char* argv[]) {
 
     } else if (headless != 2) {
         /* Not headless, switch to menu system and exit */
-        return option_handler();
+        return option_handler(&config);
     } else {
-        return headless_mode(arg_input_file, arg_output_file, size_of_groups);
+        return headless_mode(arg_input_file, arg_output_file, size_of_groups, &config);
     }
 }
\ No newline at end of file
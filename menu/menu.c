@@ -8,10 +8,13 @@
 *******************************************************************************/
 
 #include "menu.h"
-#include "../student/student.h" /* display_students sanity_check_students load_students_from_csv generate_students*/
+#include "../student/student.h" /* display_students sanity_check_students load_students_from_csv generate_students build_roster constrain_roster free_roster*/
 #include "../writer/writer.h" /*check_for_password load_students_bin save_students_bin*/
-#include "../group/group.h" /*create_initial_groups csv_groups stdout_groups*/
-#include "../solver/solver.h" /*solve*/
+#include "../group/group.h" /*create_groups init_name csv_groups stdout_groups average_happiness free_groups*/
+#include "../solver/solver.h" /*solve schedule_name strategy_name stop_reason_name*/
+#include "../components/components.h" /*solve_components*/
+#include "../island/island.h" /*solve_islands*/
+#include "../rng/rng.h" /*rng_seed*/
 
 /*******************************************************************************
  * Global variables
@@ -20,17 +23,17 @@
 extern int DEBUG;
 
 Student* students = NULL;
-Group* groups = NULL;
+Groups* groups = NULL;
+Roster* roster = NULL;          /* Dense copy of the students that were solved */
 
 int num_students = 0;           /* The number of elements in students */
 int solved = 0;                 /* If the groups were worked on */
 int unsaved_preferences = 0;    /* If the current student preferences are saved */
-int number_of_groups = 0;       /* The number of elements in groups */
 int unsaved_changes = 0;        /* If the results were saved to disk or not */
 int max_group_size = 5;         /* The maximum number of students in a group */
 
-int confidence = 3;             /* Solver parameter, controls number of swaps */
-float p = 0.00005;              /* Solver parameter, probability to accept a bad swap */
+SolverConfig config;            /* Solver parameters, starts from the command line values */
+Rng generator_rng;              /* Random stream for generating students, seeded from config */
 
 /*
     NOTES
@@ -69,6 +72,11 @@ float p = 0.00005;              /* Solver parameter, probability to accept a bad
             edit_parameters
                 edit_iteration
                 edit_prob
+                edit_group_size
+                edit_threads
+                edit_schedule
+                edit_init
+                edit_strategy
         
             solve_menu
         
@@ -543,12 +551,12 @@ void* edit_iteration() {
     printf(" ├╴Higher numbers allow for better results but takes longer to compute\n");
     printf(" ├╴Enter a new value of 0 to cancel changes\n");
     printf(" ├╴Default: 3\n");
-    printf(" ├╴Current: %d\n", confidence);
+    printf(" ├╴Current: %d\n", config.confidence);
     printf(" ├╴New value >");
 
     int new_confidence = get_amount(-1);
     if (new_confidence!=0) {
-        confidence = new_confidence;        
+        config.confidence = new_confidence;        
     }
 
     if (new_confidence > 5) {
@@ -566,12 +574,121 @@ void* edit_prob() {
     printf(" ├╴The chance for solver to accept bad changes, quite sensitive imo...\n");
     printf(" ├╴Enter a new value of 0 to cancel changes\n");
     printf(" ├╴Default: 50\n");
-    printf(" ├╴Current: %d\n", (int)(p * 1000000));
+    printf(" ├╴Current: %d\n", (int)(config.p * 1000000));
     printf(" ├╴New value >");
 
     int new_p = get_amount(-1);
     if (new_p!=0) {
-        p = (float)new_p / 1000000;    
+        config.p = (float)new_p / 1000000;    
+    }
+
+    printf(" └╴Returning back to students menu...\n");
+    return edit_parameters;
+}
+
+/* menu item, allows user to edit the number of solver threads */
+void* edit_threads() {
+    printf("\nEditing Threads\n");
+    printf(" ├╴Number of solver chains to run at once, the best result is kept\n");
+    printf(" ├╴Enter a new value of 0 to cancel changes\n");
+    printf(" ├╴Default: 1\n");
+    printf(" ├╴Current: %d\n", config.threads);
+    printf(" ├╴New value >");
+
+    int new_threads = get_amount(-1);
+    if (new_threads!=0) {
+        config.threads = new_threads;
+    }
+
+    printf(" └╴Returning back to students menu...\n");
+    return edit_parameters;
+}
+
+/* menu item, allows user to pick the rule for keeping bad swaps */
+void* edit_schedule() {
+    printf("\nEditing Schedule\n");
+    printf(" ├╴How the solver decides to keep swaps that make things worse\n");
+    printf(" ├╴[1] Fixed, uses the probability parameter\n");
+    printf(" ├╴[2] Geometric, annealing that cools over the run\n");
+    printf(" ├╴[3] Adaptive, annealing that reheats when stuck\n");
+    printf(" ├╴Enter a new value of 0 to cancel changes\n");
+    printf(" ├╴Default: 1\n");
+    printf(" ├╴Current: %d (%s)\n", config.schedule + 1, schedule_name(config.schedule));
+    printf(" ├╴New value >");
+
+    int new_schedule = get_amount(-1);
+    while (new_schedule > 3) {
+        printf(" ├╴[!] Unknown schedule, try again >");
+        new_schedule = get_amount(-1);
+    }
+
+    if (new_schedule!=0) {
+        config.schedule = new_schedule - 1;
+    }
+
+    if (config.schedule != SCHEDULE_FIXED) {
+        printf(" ├╴Starting temperature (x10000), higher keeps more bad swaps early on\n");
+        printf(" ├╴Enter a new value of 0 to keep it\n");
+        printf(" ├╴Default: 500\n");
+        printf(" ├╴Current: %d\n", (int)(config.temperature * 10000));
+        printf(" ├╴New value >");
+
+        int new_temperature = get_amount(-1);
+        if (new_temperature!=0) {
+            config.temperature = (float)new_temperature / 10000;
+        }
+    }
+
+    printf(" └╴Returning back to students menu...\n");
+    return edit_parameters;
+}
+
+/* menu item, allows user to pick how the starting groups are built */
+void* edit_init() {
+    printf("\nEditing Initial groups\n");
+    printf(" ├╴How the groups are built before the solver starts swapping\n");
+    printf(" ├╴[1] Sequential, fills groups in the order students were added\n");
+    printf(" ├╴[2] Greedy, places students next to their preferences\n");
+    printf(" ├╴Enter a new value of 0 to cancel changes\n");
+    printf(" ├╴Default: 1\n");
+    printf(" ├╴Current: %d (%s)\n", config.init + 1, init_name(config.init));
+    printf(" ├╴New value >");
+
+    int new_init = get_amount(-1);
+    while (new_init > 2) {
+        printf(" ├╴[!] Unknown initializer, try again >");
+        new_init = get_amount(-1);
+    }
+
+    if (new_init!=0) {
+        config.init = new_init - 1;
+    }
+
+    printf(" └╴Returning back to students menu...\n");
+    return edit_parameters;
+}
+
+/* menu item, allows user to pick how the solver searches */
+void* edit_strategy() {
+    printf("\nEditing Strategy\n");
+    printf(" ├╴How the solver searches for better groups\n");
+    printf(" ├╴[1] Swap, moves students between groups one swap at a time\n");
+    printf(" ├╴[2] Genetic, breeds a population of groupings\n");
+    printf(" ├╴[3] LNS, dissolves a few linked groups at a time and rebuilds them\n");
+    printf(" ├╴[4] Tabu, makes the best of a few swaps without undoing recent ones\n");
+    printf(" ├╴Enter a new value of 0 to cancel changes\n");
+    printf(" ├╴Default: 1\n");
+    printf(" ├╴Current: %d (%s)\n", config.strategy + 1, strategy_name(config.strategy));
+    printf(" ├╴New value >");
+
+    int new_strategy = get_amount(-1);
+    while (new_strategy > 4) {
+        printf(" ├╴[!] Unknown strategy, try again >");
+        new_strategy = get_amount(-1);
+    }
+
+    if (new_strategy!=0) {
+        config.strategy = new_strategy - 1;
     }
 
     printf(" └╴Returning back to students menu...\n");
@@ -603,13 +720,10 @@ void* edit_group_size() {
     if (group_size!=0) {
         
         /* Free the previous group if it exists*/
-        if (groups != NULL) {
-            for (int current_group_idx=0; current_group_idx<number_of_groups; current_group_idx++) {
-                free(groups[current_group_idx].students);
-            }
-            free(groups);
-            groups = NULL;
-        }
+        free_groups(groups);
+        groups = NULL;
+        free_roster(roster);
+        roster = NULL;
 
         unsaved_changes = 0;
 
@@ -623,12 +737,16 @@ void* edit_group_size() {
 /* menu item, allows user to edit solver paramters */
 void* edit_parameters() {
     printf("\nEdit parameters\n");
-    option load_paths[4] = {main_menu, edit_iteration, edit_prob, edit_group_size};
+    option load_paths[8] = {main_menu, edit_iteration, edit_prob, edit_group_size, edit_threads, edit_schedule, edit_init, edit_strategy};
     printf(" ├╴[0] Back to main menu\n");
     printf(" ├╴[1] Confidence\n");
     printf(" ├╴[2] Probability\n");
     printf(" ├╴[3] Group Size\n");
-    return enter_choice(load_paths, 4);
+    printf(" ├╴[4] Threads\n");
+    printf(" ├╴[5] Schedule\n");
+    printf(" ├╴[6] Initial groups\n");
+    printf(" ├╴[7] Strategy\n");
+    return enter_choice(load_paths, 8);
 }
 
 /* menu item, allows user to import student preferences from csv */
@@ -688,7 +806,7 @@ void* generate_menu() {
     
     printf(" ├╴How many students to generate? >");
     num_students = get_amount(max_group_size * 2 - 1);
-    students = generate_students(num_students);
+    students = generate_students(num_students, &generator_rng);
     unsaved_preferences = 1;
 
     return show_num_students;
@@ -728,30 +846,69 @@ void* solve_menu() {
         return solver_menu;
     }
 
-    if (groups != NULL) {
-        /* Groups contain pointer to students*/
-        for (int current_group_idx=0; current_group_idx<number_of_groups; current_group_idx++) {
-            free(groups[current_group_idx].students);
-        }
-        free(groups);
-        groups = NULL;
-    }
+    free_groups(groups);
+    groups = NULL;
+    free_roster(roster);
 
     printf("\nSolving...\n");
     unsaved_changes = 0;
-    groups = create_initial_groups(students, num_students, &number_of_groups, max_group_size);
 
-    if (number_of_groups < 2) {
+    /* Snapshot the students as dense indices, so later edits don't affect the results */
+    roster = build_roster(students, num_students);
+    if (roster != NULL && config.constraints != NULL && !constrain_roster(roster, config.constraints)) {
+        free_roster(roster);
+        roster = NULL;
+    }
+    if (roster != NULL) {
+        groups = create_groups(roster, max_group_size, config.init);
+    }
+
+    if (groups == NULL) {
+        printf(" └╴Could not create groups, going to results menu...\n");
+        free_roster(roster);
+        roster = NULL;
+        solved = 0;
+        return results_menu;
+    }
+
+    if (groups->number_of_groups < 2) {
         printf(" ├╴Group size too small, nothing to do...\n");
         printf(" └╴Going to results menu...\n");
         
+        free_groups(groups);
         groups = NULL;
         return results_menu;
     }
 
-    printf(" ├╴Initialized %d new groups...\n", number_of_groups);
-    printf(" ├╴Please wait, solving...\n");
-    solved = solve(groups, number_of_groups, confidence, p, max_group_size);
+    printf(" ├╴Initialized %d new groups...\n", groups->number_of_groups);
+    if (config.islands > 0) {
+        printf(" ├╴Please wait, solving on %d islands...\n", config.islands);
+    } else if (config.threads > 1) {
+        printf(" ├╴Please wait, solving on %d threads...\n", config.threads);
+    } else {
+        printf(" ├╴Please wait, solving...\n");
+    }
+    SolverReport report;
+    if (config.decompose) {
+        solved = solve_components(roster, &groups, &config, &report);
+    } else if (config.islands > 0) {
+        solved = solve_islands(roster, groups, &config, &report);
+    } else {
+        solved = solve(roster, groups, &config, &report);
+    }
+
+    if (solved == 1) {
+        char* unit = "swaps";
+        if (config.strategy == STRATEGY_GENETIC) {
+            unit = "children";
+        } else if (config.strategy == STRATEGY_LNS) {
+            unit = "rebuilds";
+        } else if (config.strategy == STRATEGY_TABU) {
+            unit = "steps";
+        }
+        printf(" ├╴Stopped after %lld %s in %.1fs, %s\n", report.iterations, unit, report.elapsed / 1000, stop_reason_name(report.stop_reason));
+        printf(" ├╴Average happiness %.4f, at most %.4f is possible\n", report.score, report.bound);
+    }
 
     printf(" └╴Done! Going to results menu...\n");
     
@@ -769,27 +926,25 @@ void* view_summary() {
         return results_menu;
     }
 
-    float worst_score = groups[0].happiness;
+    float worst_score = groups->happiness[0];
     int worst_index = 0;
-    float sum_happiness = 0;
 
-    /* Find the sum of happiness, worst score, and worse index */
-    for (int i=0; i< number_of_groups; i++) {
-        sum_happiness += groups[i].happiness; 
-
-        if (groups[i].happiness < worst_score) {
-            worst_score = groups[i].happiness;
+    /* Find the worst score, and worse index */
+    for (int i=0; i< groups->number_of_groups; i++) {
+        if (groups->happiness[i] < worst_score) {
+            worst_score = groups->happiness[i];
             worst_index = i;
         }
     }
 
     float num_preferences = 0;
-    for (int i=0; i<num_students; i++ ) {
-        num_preferences += students[i].preferences_size;
+    for (int i=0; i<roster->num_students; i++ ) {
+        num_preferences += roster->preferences_size[i];
     }    
 
-    float avg_happiness = sum_happiness / number_of_groups;
-    float avg_preferences = num_preferences /  num_students;
+    /* Worked out from the exact group points */
+    float avg_happiness = average_happiness(groups);
+    float avg_preferences = num_preferences /  roster->num_students;
 
     printf("Group %d had the worst score of: %.2f\n", worst_index, worst_score);
     printf("On average, %.2f out of %.2f (%.0f%%) perferences were met\n", avg_happiness*avg_preferences, avg_preferences, avg_happiness * 100);
@@ -805,7 +960,7 @@ void* show_groups() {
         return results_menu;
     }
     printf("Groups:\n");
-    stdout_groups(groups, number_of_groups);
+    stdout_groups(groups, roster);
     return results_menu;
 }
 
@@ -824,7 +979,7 @@ void* save_results() {
         return results_menu;
     }
 
-    int success = csv_groups(groups, number_of_groups, filename, max_group_size);
+    int success = csv_groups(groups, roster, filename);
 
     if (success == 0) {
         printf(" └╴Save failed? Going back to results menu...\n");
@@ -875,18 +1030,16 @@ void* students_menu() {
 void* quit() {
     
     if (groups != NULL) {
-        /* Groups contain pointer to students*/
-        for (int current_group_idx=0; current_group_idx<number_of_groups; current_group_idx++) {
-            free(groups[current_group_idx].students);
-        }
-
-        free(groups);  
+        free_groups(groups);
         groups = NULL;
         if (DEBUG) {
             printf("[DEBUG] Freed groups\n");
         }
     }
 
+    free_roster(roster);
+    roster = NULL;
+
     if (students != NULL) {
         free(students);
         if (DEBUG) {
@@ -933,12 +1086,15 @@ void* entry() {
  * Return: int 0
  *
  * Inputss
- *  - nan
+ *  - initial_config    Solver parameters to start with
  * Outputs
  *  - Switching between menu items, returns success always as errors are handled internally
  * 
  */
-int option_handler(void) {
+int option_handler(SolverConfig* initial_config) {
+    config = *initial_config;
+    rng_seed(&generator_rng, config.seed);
+
     option input = entry;
     while (input != NULL) {
         input = input(&students, &groups, solved);
@@ -4,7 +4,7 @@
 #include "../global/global.h" /* standard libraries, consts, structs */
 
 typedef void* (*option)();
-int option_handler(void);
+int option_handler(SolverConfig* initial_config);
 
 void* main_menu();
 void* students_menu();
@@ -24,6 +24,10 @@ void* import_preferences();
 void* generate_menu();
 void* edit_iteration();
 void* edit_prob();
+void* edit_threads();
+void* edit_schedule();
+void* edit_init();
+void* edit_strategy();
 void* view_summary();
 void* show_groups();
 void* save_results();
@@ -0,0 +1,180 @@
+/*******************************************************************************
+ * rng.c
+ * Small, seedable random number streams (xoshiro256**) so that every solver
+ * chain can have its own state, and runs can be reproduced from a seed
+*******************************************************************************/
+
+/*******************************************************************************
+ * Function prototypes
+*******************************************************************************/
+
+#include "rng.h"
+
+/**
+ * Rotates the bits of a 64 bit value left
+ * Return: unsigned long long
+ *
+ * Inputs
+ *  - value     the value to rotate
+ *  - shift     number of bits to rotate by
+ * Outputs
+ *  - Rotated value
+ * 
+ */
+unsigned long long rotl64(unsigned long long value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+/**
+ * splitmix64, used to spread a single seed over the whole generator state
+ * Return: unsigned long long
+ *
+ * Inputs
+ *  - x         pointer to the splitmix state, advanced on every call
+ * Outputs
+ *  - Next well mixed 64 bit value
+ * 
+ */
+unsigned long long splitmix64(unsigned long long* x) {
+    unsigned long long z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Seeds a random stream
+ * Return: void
+ *
+ * Inputs
+ *  - rng       the stream to seed
+ *  - seed      any 64 bit value, the same seed always gives the same stream
+ * Outputs
+ *  - Seeded stream
+ * 
+ */
+void rng_seed(Rng* rng, unsigned long long seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = splitmix64(&seed);
+    }
+}
+
+/**
+ * Gets the next 64 random bits
+ * Return: unsigned long long
+ *
+ * Inputs
+ *  - rng       the stream to advance
+ * Outputs
+ *  - Random 64 bit value
+ * 
+ */
+unsigned long long rng_next(Rng* rng) {
+    unsigned long long* s = rng->s;
+    unsigned long long result = rotl64(s[1] * 5, 7) * 9;
+    unsigned long long t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+
+    return result;
+}
+
+/**
+ * Advances a stream by 2^128 values, used to split one seed into
+ * non-overlapping streams
+ * Return: void
+ *
+ * Inputs
+ *  - rng       the stream to advance
+ * Outputs
+ *  - Advanced stream
+ * 
+ */
+void rng_jump(Rng* rng) {
+    static const unsigned long long jump[4] = {
+        0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+    };
+
+    unsigned long long s[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (jump[i] & (1ULL << b)) {
+                s[0] ^= rng->s[0];
+                s[1] ^= rng->s[1];
+                s[2] ^= rng->s[2];
+                s[3] ^= rng->s[3];
+            }
+            rng_next(rng);
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        rng->s[i] = s[i];
+    }
+}
+
+/**
+ * Seeds the nth independent stream of a seed, eg: one per solver thread
+ * Return: void
+ *
+ * Inputs
+ *  - rng       the stream to seed
+ *  - seed      the shared seed
+ *  - stream    which stream to use, 0 is the same as rng_seed()
+ * Outputs
+ *  - Seeded stream
+ * 
+ */
+void rng_stream(Rng* rng, unsigned long long seed, int stream) {
+    rng_seed(rng, seed);
+    for (int i = 0; i < stream; i++) {
+        rng_jump(rng);
+    }
+}
+
+/**
+ * Gets a random integer in [0, bound) without the bias of "% bound"
+ * (Lemire's multiply and reject method)
+ * Return: unsigned int
+ *
+ * Inputs
+ *  - rng       the stream to use
+ *  - bound     the exclusive upper limit, must be larger than 0
+ * Outputs
+ *  - Uniform random integer below bound
+ * 
+ */
+unsigned int rng_below(Rng* rng, unsigned int bound) {
+    unsigned long long m = (rng_next(rng) >> 32) * bound;
+    unsigned int low = (unsigned int)m;
+
+    /* Reject the few values that would make some results more likely */
+    if (low < bound) {
+        unsigned int threshold = -bound % bound;
+        while (low < threshold) {
+            m = (rng_next(rng) >> 32) * bound;
+            low = (unsigned int)m;
+        }
+    }
+
+    return (unsigned int)(m >> 32);
+}
+
+/**
+ * Gets a random double in [0, 1)
+ * Return: double
+ *
+ * Inputs
+ *  - rng       the stream to use
+ * Outputs
+ *  - Uniform random double
+ * 
+ */
+double rng_double(Rng* rng) {
+    return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
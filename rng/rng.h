@@ -0,0 +1,14 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include "../global/global.h" /* standard libraries, consts, structs */
+
+unsigned long long splitmix64(unsigned long long* x);
+void rng_seed(Rng* rng, unsigned long long seed);
+void rng_jump(Rng* rng);
+void rng_stream(Rng* rng, unsigned long long seed, int stream);
+unsigned long long rng_next(Rng* rng);
+unsigned int rng_below(Rng* rng, unsigned int bound);
+double rng_double(Rng* rng);
+
+#endif
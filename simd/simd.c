@@ -0,0 +1,193 @@
+/*******************************************************************************
+ * simd.c
+ * Vectorised group scoring, picked at runtime for whatever the CPU supports
+*******************************************************************************/
+
+/*******************************************************************************
+ * Function prototypes
+*******************************************************************************/
+
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  /* SSE2 and AVX2 intrinsics */
+#define SIMD_X86
+#endif
+
+/*******************************************************************************
+ * Global variables
+*******************************************************************************/
+
+extern int DEBUG;
+extern int preference_points[];
+
+/*
+    Constants
+*/
+#define SIMD_PAD        -2      /* Fills unused member lanes, never a student or an unknown preference (-1) */
+
+/**
+ * Finds the widest vector instructions this CPU supports
+ * Return: int, one of the SIMD_ constants
+ *
+ * Inputs
+ *  - nan
+ * Outputs
+ *  - Supported instructions
+ * 
+ */
+int simd_support() {
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SIMD_SSE2;
+    }
+#endif
+    return SIMD_NONE;
+}
+
+/**
+ * Gets the name of some vector instructions
+ * Return: char*
+ *
+ * Inputs
+ *  - simd      One of the SIMD_ constants
+ * Outputs
+ *  - Name of the instructions
+ * 
+ */
+char* simd_name(int simd) {
+    if (simd == SIMD_AVX2) {
+        return "avx2";
+    } else if (simd == SIMD_SSE2) {
+        return "sse2";
+    }
+    return "none";
+}
+
+/**
+ * Copies the members of a group into SIMD_MAX_SIZE lanes, padding the rest
+ * Return: int, the size of the group
+ *
+ * Inputs
+ *  - groups    The groups
+ *  - group     Index of the group, at most SIMD_MAX_SIZE students
+ *  - lanes     Filled with the members then SIMD_PAD
+ * Outputs
+ *  - Padded members
+ * 
+ */
+int load_lanes(Groups* groups, int group, int lanes[SIMD_MAX_SIZE]) {
+    int size = groups->group_size[group];
+    int* members = &groups->members[group * groups->max_group_size];
+
+    for (int i=0; i<SIMD_MAX_SIZE; i++) {
+        lanes[i] = (i < size) ? members[i] : SIMD_PAD;
+    }
+    return size;
+}
+
+#ifdef SIMD_X86
+
+/**
+ * Adds up the points of every member of a group with SSE2, each preference
+ * is broadcast and compared against all the members at once
+ * Return: int
+ *
+ * Inputs
+ *  - roster    Dense students
+ *  - groups    The groups
+ *  - group     Index of the group, at most SIMD_MAX_SIZE students
+ * Outputs
+ *  - Group points
+ * 
+ */
+__attribute__((target("sse2")))
+int group_points_sse2(Roster* roster, Groups* groups, int group) {
+    int lanes[SIMD_MAX_SIZE];
+    int size = load_lanes(groups, group, lanes);
+    __m128i low = _mm_loadu_si128((__m128i*)&lanes[0]);
+    __m128i high = _mm_loadu_si128((__m128i*)&lanes[4]);
+
+    int points = 0;
+    for (int i=0; i<size; i++) {
+        int* preferences = &roster->preferences[lanes[i] * MAX_STUDENT_PREFERENCES];
+        int preferences_size = roster->preferences_size[lanes[i]];
+
+        int satisfied = 0;
+        for (int j=0; j<MAX_STUDENT_PREFERENCES; j++) {
+            __m128i preference = _mm_set1_epi32(preferences[j]);
+            __m128i hits = _mm_or_si128(_mm_cmpeq_epi32(low, preference), _mm_cmpeq_epi32(high, preference));
+            satisfied += _mm_movemask_epi8(hits) != 0;
+        }
+
+        points += satisfied * preference_points[preferences_size] + (preferences_size == 0) * HAPPINESS_SCALE;
+    }
+    return points;
+}
+
+/**
+ * Adds up the points of every member of a group with AVX2, all the members
+ * fit in a single register
+ * Return: int
+ *
+ * Inputs
+ *  - roster    Dense students
+ *  - groups    The groups
+ *  - group     Index of the group, at most SIMD_MAX_SIZE students
+ * Outputs
+ *  - Group points
+ * 
+ */
+__attribute__((target("avx2")))
+int group_points_avx2(Roster* roster, Groups* groups, int group) {
+    int lanes[SIMD_MAX_SIZE];
+    int size = load_lanes(groups, group, lanes);
+    __m256i members = _mm256_loadu_si256((__m256i*)lanes);
+
+    int points = 0;
+    for (int i=0; i<size; i++) {
+        int* preferences = &roster->preferences[lanes[i] * MAX_STUDENT_PREFERENCES];
+        int preferences_size = roster->preferences_size[lanes[i]];
+
+        int satisfied = 0;
+        for (int j=0; j<MAX_STUDENT_PREFERENCES; j++) {
+            __m256i hits = _mm256_cmpeq_epi32(members, _mm256_set1_epi32(preferences[j]));
+            satisfied += _mm256_movemask_epi8(hits) != 0;
+        }
+
+        points += satisfied * preference_points[preferences_size] + (preferences_size == 0) * HAPPINESS_SCALE;
+    }
+    return points;
+}
+
+#endif
+
+/**
+ * Picks the vectorised group points kernel for some instructions and group size
+ * Return: points_kernel, NULL if there is none for them
+ *
+ * Inputs
+ *  - simd              One of the SIMD_ constants, from simd_support()
+ *  - max_group_size    The size of the groups being scored
+ * Outputs
+ *  - Vectorised kernel
+ * 
+ */
+points_kernel simd_points_kernel(int simd, int max_group_size) {
+    if (max_group_size > SIMD_MAX_SIZE) {
+        return NULL;
+    }
+
+#ifdef SIMD_X86
+    if (simd == SIMD_AVX2) {
+        return group_points_avx2;
+    } else if (simd == SIMD_SSE2) {
+        return group_points_sse2;
+    }
+#endif
+    return NULL;
+}
@@ -0,0 +1,13 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "../global/global.h" /* standard libraries, consts, structs */
+
+/* Adds up the points of every member of a group */
+typedef int (*points_kernel)(Roster* roster, Groups* groups, int group);
+
+int simd_support();
+char* simd_name(int simd);
+points_kernel simd_points_kernel(int simd, int max_group_size);
+
+#endif
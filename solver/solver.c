@@ -9,46 +9,324 @@
 
 #include "solver.h"
 
+#include <pthread.h>    /* pthread_create, pthread_join, pthread_mutex_t */
+#include <time.h>       /* time */
+#include <math.h>       /* exp, pow */
+
+#include "../group/group.h" /* copy_groups copy_groups_into free_groups */
+#include "../rng/rng.h"     /* rng_stream rng_jump rng_below rng_double splitmix64 */
+#include "../utils/utils.h" /* time_ms */
+#include "../genetic/genetic.h" /* solve_genetic */
+#include "../checkpoint/checkpoint.h" /* roster_fingerprint save_checkpoint load_checkpoint free_checkpoint */
+#include "../simd/simd.h"   /* points_kernel simd_support simd_name simd_points_kernel */
+#include "../island/island.h" /* migrate_island */
+
 /*******************************************************************************
  * Global variables
 *******************************************************************************/
 
 extern int DEBUG;
 
+/*
+    Constants
+*/
+#define SYNC_INTERVAL   10000   /* Iterations between chains comparing against the best result */
+#define RESTART_LAG     0.02    /* Fraction behind the best score before a chain restarts from it */
+#define CHECK_INTERVAL  256     /* Iterations between checking the clock and cooling */
+#define FINAL_COOLING   0.001   /* Final temperature as a fraction of the starting temperature */
+#define REHEAT_WINDOW   0.05    /* Fraction of the run without a new best before reheating */
+#define REHEAT_FACTOR   0.5     /* Each reheat starts this much cooler than the last */
+#define DIRECTED_TRIES  8       /* Students looked at when searching for one with unmet preferences */
+#define SWAP_WEIGHT     8       /* Relative chance of proposing a swap... */
+#define RELOCATE_WEIGHT 1       /* ...a relocation... */
+#define ROTATE_WEIGHT   1       /* ...or a rotation, out of the enabled moves */
+#define RELOCATE_TRIES  8       /* Groups looked at when searching for one to relocate out of */
+#define REFINE_PASSES   10      /* Most passes over the linked group pairs when refining */
+#define REFINE_STEPS    8       /* Most swaps in a single refinement sequence */
+#define REFINE_MAX_SIZE 32      /* Largest groups worth refining, the work grows with the size cubed */
+#define REFINE_SHARE    0.1     /* Fraction of a time limit kept back for refining */
+#define REFINE_CHECK    64      /* Pairs of groups refined between checking the clock */
+#define LNS_GROUPS      4       /* Groups dissolved in each large neighbourhood step */
+#define LNS_REPAIRS     4       /* Randomised greedy rebuilds tried per step, the best is kept */
+#define TABU_CANDIDATES 32      /* Swaps sampled in each tabu step, the best allowed one is made */
+#define TABU_TENURE     8       /* Shortest number of steps a moved student stays tabu, up to twice this */
+#define TABU_HISTORY    (1 << 16) /* Slots in the table of recently seen grouping hashes, a power of two */
+#define MAX_SIZE_WEIGHT (1 << 24) /* Largest group size weight, past it larger groups are rounded */
+
+/* Best result found by any chain, shared between the solver threads */
+typedef struct {
+    pthread_mutex_t lock;
+    Groups* groups;
+    long long score;
+} SharedBest;
+
+/* State of a single solver chain */
+typedef struct {
+    Roster* roster;
+    Groups* groups;
+    long long score;        /* Sum of the group scores, see group_score() */
+    long long weight;       /* Size weight the group scores are worked out with */
+    float p;
+    float directed;         /* [0-1] Fraction of proposals aimed at unmet preferences */
+    int moves;              /* MOVE_ flags that can be proposed */
+    int* open_groups;       /* Groups with room for another student */
+    int* open_index;        /* Position of each group in open_groups, -1 if full */
+    int open_count;
+    int strategy;           /* STRATEGY_SWAP, STRATEGY_LNS or STRATEGY_TABU */
+
+    /* Scratch space for large neighbourhood steps, LNS_GROUPS * max_group_size students each */
+    int* lns_students;      /* Students of the dissolved groups */
+    int* lns_saved;         /* Members of the dissolved groups before the step */
+    int* lns_best;          /* Members of the best rebuild so far */
+
+    /* Scratch space for moving must-be-together sets, 2 * max_group_size slots, only allocated with constraints */
+    int* set_slots;
+
+    /* Tabu memory, only allocated for tabu search */
+    long long* tabu_until;  /* Iteration each student can be moved again at */
+    unsigned long long* tabu_seen; /* TABU_HISTORY recently seen grouping hashes */
+    unsigned long long tabu_hash; /* Zobrist hash of the current grouping */
+    Rng rng;                /* Private random stream */
+    SharedBest* shared;     /* NULL when running on a single thread */
+    struct IslandSegment* island_segment; /* Segment of the island being solved, NULL when not an island */
+    int island;             /* Index of the island being solved */
+    long long migration_interval; /* Iterations between trading groups with the other islands, 0 when not an island */
+
+    /* Stopping state */
+    long long num_iter;     /* Iteration budget, -1 when running on a time limit */
+    double start_time;      /* time_ms() when solving started */
+    int time_limit;         /* Milliseconds to run for, 0 for no limit */
+    int stall_limit;        /* Accepted swaps without improving before stopping, 0 for no limit */
+    double progress;        /* [0-1] How much of the budget has been used */
+    long long bound_score;  /* Score no grouping can beat, -1 if it isn't exact */
+    long long iterations;   /* Swaps proposed so far */
+    long long accepted;     /* Swaps kept so far */
+    int stalled;            /* Accepted swaps since the last new best */
+    int stop_reason;        /* One of the STOP_ constants */
+
+    /* Annealing state */
+    int schedule;
+    float temperature;      /* Current temperature */
+    float cycle_temperature;/* Temperature at the start of the current cooling cycle */
+    double cycle_start;     /* Progress the current cooling cycle started at */
+    long long best_score;   /* Best score the chain has seen */
+    double last_improvement;/* Progress best_score was last raised at */
+
+    /* Copy of the best groups, only taken before reheating */
+    Groups* snapshot;
+    long long snapshot_score;
+
+    /* Checkpointing state */
+    char* checkpoint;       /* File to save to, NULL to never save */
+    int checkpoint_interval;/* Milliseconds between saves */
+    double last_checkpoint; /* time_ms() of the last save */
+    int writes_checkpoints; /* Only one chain saves when running on multiple threads */
+    unsigned long long fingerprint;
+
+    /* Tracing state, only the first chain is traced */
+    FILE* trace;            /* Open trace file, NULL to never sample */
+    int trace_json;         /* 1 for JSON lines, 0 for CSV */
+    int trace_interval;     /* Milliseconds between samples */
+    double last_trace;      /* time_ms() of the last sample */
+    long long last_trace_iterations; /* Iterations at the last sample */
+    long long worsened;     /* Kept moves that lowered the score */
+} Chain;
+
 /**
- * Finds how many student preferences (as a percentage) are satisfied
- * Return: float
+ * Finds how many points a student gets from their satisfied preferences,
+ * each met preference is worth an equal share of HAPPINESS_SCALE
+ * Return: int
  *
  * Inputs
- *  - student   The student to find the happiness of
- *  - group     The group that the student is in
+ *  - roster    Dense students
+ *  - student   The dense index of the student to find the points of
+ *  - group     The index of the group to check against
+ *  - group_of  The group index of every student
  * Outputs
- *  - [0-1] Float of student happiness 
+ *  - [0-HAPPINESS_SCALE] Student points
  * 
  */
-float student_happiness(Student student, Group group) {
+int student_points(Roster* roster, int student, int group, int* group_of) {
     
-    if (student.preferences_size == 0) {
-        return 1;
+    int preferences_size = roster->preferences_size[student];
+    if (preferences_size == 0) {
+        return HAPPINESS_SCALE;
     }
 
-    float num_satisfied = 0;
-    
-    for (int i=0; i<student.preferences_size; i++) {
+    int* preferences = &roster->preferences[student * MAX_STUDENT_PREFERENCES];
+    int num_satisfied = 0;
 
-        /* Search within group if preference was met */
-        for (int j=0; j<group.group_size; j++) {
-            if (student.preferences[i] == group.students[j]->student_id) {
-        
-                /* Increment the number of preferences satisfied */
-                num_satisfied++;
-                
-            }
+    /* A preference is met if that student is in the same group */
+    for (int i=0; i<preferences_size; i++) {
+        if (preferences[i] != -1 && group_of[preferences[i]] == group) {
+            num_satisfied++;
         }
     }
     
-    /* Return average */
-    return num_satisfied / (float) (student.preferences_size);
+    return num_satisfied * (HAPPINESS_SCALE / preferences_size);
+}
+
+/**
+ * Finds how many student preferences (as a percentage) are satisfied
+ * Return: float
+ *
+ * Inputs
+ *  - roster    Dense students
+ *  - student   The dense index of the student to find the happiness of
+ *  - group     The index of the group to check against
+ *  - group_of  The group index of every student
+ * Outputs
+ *  - [0-1] Float of student happiness 
+ * 
+ */
+float student_happiness(Roster* roster, int student, int group, int* group_of) {
+    return student_points(roster, student, group, group_of) / (float) HAPPINESS_SCALE;
+}
+
+/**
+ * Sets the points of a group and the happiness worked out from them
+ * Return: void
+ *
+ * Inputs
+ *  - groups    The groups
+ *  - group     Index of the target group, its size must be up to date
+ *  - points    The group's new points
+ * Outputs
+ *  - Updated points and happiness
+ * 
+ */
+void set_group_points(Groups* groups, int group, int points) {
+    int size = groups->group_size[group];
+    groups->points[group] = points;
+    groups->happiness[group] = (size > 0) ? points / (float) (HAPPINESS_SCALE * size) : 0;
+}
+
+/**
+ * Adds up the points of every member of a group, works for any group size
+ * Return: int
+ *
+ * Inputs
+ *  - roster    Dense students
+ *  - groups    The groups
+ *  - group     Index of the target group
+ * Outputs
+ *  - Group points
+ * 
+ */
+int group_points(Roster* roster, Groups* groups, int group) {
+    int points = 0;
+    int* members = &groups->members[group * groups->max_group_size];
+
+    /* For each student, compute their points */
+    for (int i=0; i<groups->group_size[group]; i++) {
+        points += student_points(roster, members[i], group, groups->group_of);
+    }
+
+    return points;
+}
+
+/* Points a single met preference is worth, by number of preferences */
+int preference_points[MAX_STUDENT_PREFERENCES + 1] = {
+    0,
+    HAPPINESS_SCALE / 1,
+    HAPPINESS_SCALE / 2,
+    HAPPINESS_SCALE / 3,
+    HAPPINESS_SCALE / 4,
+    HAPPINESS_SCALE / 5
+};
+
+/*
+    Defines group_points_SIZE(), group_points() for full groups of exactly
+    SIZE students. Every preference slot is compared against every member,
+    unused slots hold -1 and never match, so all the trip counts are known at
+    compile time and the loops unroll without any branches. Any other group
+    falls back to group_points()
+*/
+#define GROUP_POINTS_KERNEL(SIZE)                                                       \
+int group_points_##SIZE(Roster* roster, Groups* groups, int group) {                    \
+    if (groups->max_group_size != SIZE || groups->group_size[group] != SIZE) {          \
+        return group_points(roster, groups, group);                                     \
+    }                                                                                   \
+                                                                                        \
+    int* members = &groups->members[group * SIZE];                                      \
+    int points = 0;                                                                     \
+    for (int i=0; i<SIZE; i++) {                                                        \
+        int* preferences = &roster->preferences[members[i] * MAX_STUDENT_PREFERENCES];  \
+        int preferences_size = roster->preferences_size[members[i]];                    \
+        int satisfied = 0;                                                              \
+        for (int j=0; j<MAX_STUDENT_PREFERENCES; j++) {                                 \
+            int met = 0;                                                                \
+            for (int k=0; k<SIZE; k++) {                                                \
+                met |= (preferences[j] == members[k]);                                  \
+            }                                                                           \
+            satisfied += met;                                                           \
+        }                                                                               \
+        points += satisfied * preference_points[preferences_size]                       \
+            + (preferences_size == 0) * HAPPINESS_SCALE;                                \
+    }                                                                                   \
+    return points;                                                                      \
+}
+
+GROUP_POINTS_KERNEL(2)
+GROUP_POINTS_KERNEL(3)
+GROUP_POINTS_KERNEL(4)
+GROUP_POINTS_KERNEL(5)
+GROUP_POINTS_KERNEL(6)
+GROUP_POINTS_KERNEL(7)
+GROUP_POINTS_KERNEL(8)
+
+/* Group points kernel in use, picked by solve() for the group size being solved */
+points_kernel group_points_kernel = group_points;
+
+/**
+ * Picks the group points kernel for a group size, vectorised if the CPU
+ * supports it, otherwise unrolled for the size
+ * Return: points_kernel
+ *
+ * Inputs
+ *  - max_group_size    The size of the groups being solved
+ *  - simd              One of the SIMD_ constants, from simd_support()
+ * Outputs
+ *  - Specialised kernel, or group_points() for uncommon sizes
+ * 
+ */
+points_kernel select_points_kernel(int max_group_size, int simd) {
+    points_kernel kernel = simd_points_kernel(simd, max_group_size);
+    if (kernel != NULL) {
+        return kernel;
+    }
+
+    switch (max_group_size) {
+        case 2: return group_points_2;
+        case 3: return group_points_3;
+        case 4: return group_points_4;
+        case 5: return group_points_5;
+        case 6: return group_points_6;
+        case 7: return group_points_7;
+        case 8: return group_points_8;
+    }
+    return group_points;
+}
+
+/**
+ * Makes group_points_kernel the kernel for a group size. It is only written
+ * when it changes, so once it is picked before starting threads, solvers
+ * running on those threads only ever read it
+ * Return: int, the SIMD_ constant the CPU supports
+ *
+ * Inputs
+ *  - max_group_size    The size of the groups being solved
+ * Outputs
+ *  - Updated group_points_kernel
+ * 
+ */
+int use_points_kernel(int max_group_size) {
+    int simd = simd_support();
+    points_kernel kernel = select_points_kernel(max_group_size, simd);
+    if (group_points_kernel != kernel) {
+        group_points_kernel = kernel;
+    }
+    return simd;
 }
 
 /**
@@ -56,63 +334,359 @@ float student_happiness(Student student, Group group) {
  * Return: float
  *
  * Inputs
- *  - group     Pointer to target group
+ *  - roster    Dense students
+ *  - groups    The groups
+ *  - group     Index of the target group
  * Outputs
  *  - Returns the newly calculated in group happiness
  * 
  */
-float set_group_happiness(Group *group) {
-    float sum_of_scores = 0;
-    float num_of_scores = 0;
+float set_group_happiness(Roster* roster, Groups* groups, int group) {
+    set_group_points(groups, group, group_points_kernel(roster, groups, group));
+    return groups->happiness[group];
+}
+
+/**
+ * Finds the smallest number every group size up to max_group_size divides,
+ * so group averages can be kept as whole numbers. Stops growing once it
+ * would pass MAX_SIZE_WEIGHT, larger groups are then rounded down
+ * Return: long long
+ *
+ * Inputs
+ *  - max_group_size    The largest size a group can have
+ * Outputs
+ *  - Size weight
+ * 
+ */
+long long size_weight(int max_group_size) {
+    long long weight = 1;
+
+    for (int size=2; size<=max_group_size; size++) {
+        /* Greatest common divisor, to find the least common multiple */
+        long long a = weight;
+        long long b = size;
+        while (b != 0) {
+            long long rest = a % b;
+            a = b;
+            b = rest;
+        }
 
-    /* For each student, compute their happiness */
-    for (int i=0; i<group->group_size; i++) {
-        num_of_scores = num_of_scores + 1;
-        sum_of_scores = sum_of_scores + student_happiness(*group->students[i], *group);
+        long long next = weight / a * size;
+        if (next > MAX_SIZE_WEIGHT) {
+            break;
+        }
+        weight = next;
     }
 
-    if (num_of_scores == 0) {
-        group->happiness = 0;
+    return weight;
+}
+
+/**
+ * Scores a group as a whole number, its happiness in units of
+ * 1 / (HAPPINESS_SCALE * weight). Sums and differences of these are exact,
+ * so the solver's running score never drifts
+ * Return: long long
+ *
+ * Inputs
+ *  - points    The group's points
+ *  - size      The group's size
+ *  - weight    Size weight from size_weight()
+ * Outputs
+ *  - Group score
+ * 
+ */
+long long group_score(int points, int size, long long weight) {
+    if (size == 0) {
         return 0;
     }
-    group->happiness = sum_of_scores / num_of_scores;
-    return group->happiness;
+    return points * weight / size;
+}
+
+/**
+ * Finds how much a group's score would change if its points and size changed
+ * Return: long long
+ *
+ * Inputs
+ *  - groups        The groups
+ *  - group         Index of the group
+ *  - points_delta  Change in the group's points
+ *  - size_delta    Change in the group's size
+ *  - weight        Size weight from size_weight()
+ * Outputs
+ *  - Change in the group's score
+ * 
+ */
+long long group_score_delta(Groups* groups, int group, int points_delta, int size_delta, long long weight) {
+    int points = groups->points[group];
+    int size = groups->group_size[group];
+    return group_score(points + points_delta, size + size_delta, weight) - group_score(points, size, weight);
+}
+
+/**
+ * Sums the scores of every group
+ * Return: long long
+ *
+ * Inputs
+ *  - groups    The groups, points must be up to date
+ *  - weight    Size weight from size_weight()
+ * Outputs
+ *  - Total score
+ * 
+ */
+long long groups_score(Groups* groups, long long weight) {
+    long long score = 0;
+    for (int i=0; i<groups->number_of_groups; i++) {
+        score += group_score(groups->points[i], groups->group_size[i], weight);
+    }
+    return score;
+}
+
+
+/**
+ * Finds the most points a student could ever get. Only known preferences
+ * can be met, and only as many as fit in a group next to the student's own
+ * must-be-together set and theirs, without anyone they must be apart from
+ * Return: int, [0-HAPPINESS_SCALE] points
+ *
+ * Inputs
+ *  - roster            Dense students
+ *  - student           Dense index of the student
+ *  - max_group_size    Largest number of students in a group
+ *  - set_size          Size of each must-be-together set by its first student, NULL without constraints
+ * Outputs
+ *  - Most points the student could get
+ * 
+ */
+int student_cap(Roster* roster, int student, int max_group_size, int* set_size) {
+    int preferences_size = roster->preferences_size[student];
+    if (preferences_size == 0) {
+        return HAPPINESS_SCALE;
+    }
+    int* preferences = &roster->preferences[student * MAX_STUDENT_PREFERENCES];
+
+    /* There are few enough preferences to try every subset of them */
+    int best = 0;
+    for (int subset=1; subset<(1 << preferences_size); subset++) {
+        int met = 0;
+        int fits = 1;
+        int sets[MAX_STUDENT_PREFERENCES + 1];
+        sets[0] = (set_size != NULL) ? roster->together[student] : student;
+        int num_sets = 1;
+        int size = (set_size != NULL) ? set_size[sets[0]] : 1;
+
+        for (int i=0; i<preferences_size && fits; i++) {
+            if (!(subset & (1 << i))) {
+                continue;
+            }
+            int other = preferences[i];
+            met++;
+            if (other == -1) {
+                fits = 0;
+                break;
+            }
+
+            /* Each set takes up room once */
+            int set = (set_size != NULL) ? roster->together[other] : other;
+            int seen = 0;
+            for (int j=0; j<num_sets; j++) {
+                seen |= sets[j] == set;
+            }
+            if (!seen) {
+                sets[num_sets++] = set;
+                size += (set_size != NULL) ? set_size[set] : 1;
+            }
+
+            if (set_size != NULL) {
+                for (int j=roster->apart_start[student]; j<roster->apart_start[student + 1]; j++) {
+                    fits &= roster->apart[j] != other;
+                }
+            }
+        }
+
+        if (fits && size <= max_group_size && met > best) {
+            best = met;
+        }
+    }
+
+    return best * HAPPINESS_SCALE / preferences_size;
 }
 
+/**
+ * Finds a score no grouping can beat. Every student is capped by
+ * student_cap(), and the caps are handed out highest first to the smallest
+ * groups, since a student counts for more in a smaller group. The total
+ * handed out is also capped by the preference graph, a student can only be
+ * in a group with a few of the students that prefer them. When
+ * relocations can change the group sizes, the most uneven sizes they could
+ * reach are used, no other sizes give a higher bound
+ * Return: long long, the bound, -1 if it couldn't be worked out exactly
+ *
+ * Inputs
+ *  - roster            Dense students
+ *  - groups            Groups being solved
+ *  - weight            Size weight from size_weight()
+ *  - sizes_change      1 if moves can change the group sizes
+ *  - bound             Set to the highest reachable average happiness
+ * Outputs
+ *  - Upper bound of the score
+ * 
+ */
+long long score_bound(Roster* roster, Groups* groups, long long weight, int sizes_change, double* bound) {
+    int num_students = roster->num_students;
+    int number_of_groups = groups->number_of_groups;
+    int max_group_size = groups->max_group_size;
+
+    int* set_size = NULL;
+    int* sizes = (int*)calloc(max_group_size + 1, sizeof(int));
+    if (roster->together != NULL) {
+        set_size = (int*)calloc(num_students + 1, sizeof(int));
+    }
+    if (sizes == NULL || (roster->together != NULL && set_size == NULL)) {
+        free(sizes);
+        free(set_size);
+        *bound = 1;
+        return -1;
+    }
+
+    if (set_size != NULL) {
+        for (int i=0; i<num_students; i++) {
+            set_size[roster->together[i]]++;
+        }
+    }
+
+    /* Count the caps, there are only HAPPINESS_SCALE + 1 possible ones */
+    int caps[HAPPINESS_SCALE + 1] = {0};
+    for (int i=0; i<num_students; i++) {
+        caps[student_cap(roster, i, max_group_size, set_size)]++;
+    }
+
+    /* Count the group sizes */
+    int smallest = max_group_size;
+    int largest = 1;
+    for (int i=0; i<number_of_groups; i++) {
+        int size = groups->group_size[i];
+        sizes[size]++;
+        smallest = (size > 0 && size < smallest) ? size : smallest;
+        largest = (size > largest) ? size : largest;
+    }
+
+    /*
+        Each met preference is worth its share of the student's points, and
+        at most largest - 1 of the students that prefer someone can be in
+        their group, so only that many of the best shares count. listed_by
+        is in student order, so a student listing someone twice is adjacent
+    */
+    long long total = 0;
+    int shares[HAPPINESS_SCALE + 1] = {0};
+    for (int i=0; i<num_students; i++) {
+        if (roster->preferences_size[i] == 0) {
+            total += HAPPINESS_SCALE;
+        }
+
+        int end = roster->listed_by_start[i + 1];
+        for (int j=roster->listed_by_start[i]; j<end; ) {
+            int other = roster->listed_by[j];
+            int listed = 0;
+            while (j < end && roster->listed_by[j] == other) {
+                listed++;
+                j++;
+            }
+
+            int share = listed * HAPPINESS_SCALE / roster->preferences_size[other];
+            if (other == i) {
+                total += share;
+            } else {
+                shares[share]++;
+            }
+        }
+
+        int room = largest - 1;
+        for (int share=HAPPINESS_SCALE; share>0; share--) {
+            int taken = (shares[share] < room) ? shares[share] : room;
+            total += (long long) taken * share;
+            room -= taken;
+            shares[share] = 0;
+        }
+    }
+
+    /* As many of the smallest groups as the rest can make up for without passing the largest */
+    if (sizes_change && largest > smallest) {
+        memset(sizes, 0, sizeof(int) * (max_group_size + 1));
+        int small = (number_of_groups * largest - num_students) / (largest - smallest);
+        if (small >= number_of_groups) {
+            small = number_of_groups;
+        } else {
+            sizes[num_students - small * smallest - (number_of_groups - small - 1) * largest]++;
+            sizes[largest] += number_of_groups - small - 1;
+        }
+        sizes[smallest] += small;
+    }
+
+    int exact = 1;
+    long long score = 0;
+    double happiness = 0;
+    int cap = HAPPINESS_SCALE;
+    for (int size=1; size<=max_group_size; size++) {
+        for (int group=0; group<sizes[size]; group++) {
+            long long points = 0;
+            for (int i=0; i<size; i++) {
+                while (cap > 0 && caps[cap] == 0) {
+                    cap--;
+                }
+                caps[cap]--;
+
+                int given = (cap < total) ? cap : (int) total;
+                points += given;
+                total -= given;
+            }
+
+            exact &= (points * weight) % size == 0;
+            score += points * weight / size;
+            happiness += (double) points / (HAPPINESS_SCALE * size);
+        }
+    }
+
+    free(sizes);
+    free(set_size);
+
+    *bound = happiness / number_of_groups;
+    return exact ? score : -1;
+}
 
 /**
  * Finds two students that can be swapped
  * Return: void
  *
  * Inputs
- *   groups             Array of group struct
- *   number_of_groups   the number of elements in groups
+ *   groups             The groups
  *   g1                 The first group index
  *   g2                 The second group index
  *   s1                 The index of the student in g1
  *   s2                 The index of the student in g2 
+ *   rng                The chain's random stream
  * Outputs
  *  - Finds two students that can be swapped
  * 
  */
-void compute_proposal(Group* groups, int number_of_groups, int* g1, int* g2, int* s1, int* s2) {
+void compute_proposal(Groups* groups, int* g1, int* g2, int* s1, int* s2, Rng* rng) {
+    int number_of_groups = groups->number_of_groups;
 
     int valid_swap = 0;
     while (!valid_swap) {
 
         /* Get two groups */
-        *g1 = (int) (rand() % (number_of_groups));
-        *g2 = (int) (rand() % (number_of_groups));
+        *g1 = (int) rng_below(rng, number_of_groups);
+        *g2 = (int) rng_below(rng, number_of_groups);
 
         /* Make sure they're not the same group */
         if (*g1 != *g2) {
 
             /* Be bias against "solved" groups */
-            if ((groups[*g1].happiness < 0.9 && groups[*g2].happiness < 0.9) || 0.8 < (double)rand() / (double)RAND_MAX) {
+            if ((groups->happiness[*g1] < 0.9 && groups->happiness[*g2] < 0.9) || 0.8 < rng_double(rng)) {
 
                 /* Get two students */
-                *s1 = (int) (rand() % groups[*g1].group_size);
-                *s2 = (int) (rand() % groups[*g2].group_size);
+                *s1 = (int) rng_below(rng, groups->group_size[*g1]);
+                *s2 = (int) rng_below(rng, groups->group_size[*g2]);
 
                 /* no need to check if they are the same as they are in different groups */
                 valid_swap = 1;
@@ -123,147 +697,2701 @@ void compute_proposal(Group* groups, int number_of_groups, int* g1, int* g2, int
 }
 
 /**
- * Swaps two students
- * Return: void
+ * Counts the links a student has inside a group, a link is one of their
+ * preferences or a student that prefers them
+ * Return: int
  *
  * Inputs
- *   groups     Array of group struct
- *   g1         The first group index
- *   g2         The second group index
- *   s1         The index of the student in g1
- *   s2         The index of the student in g2 
+ *   roster     Dense students
+ *   groups     The groups
+ *   student    Dense index of the student
+ *   group      Index of the group
  * Outputs
- *  - Swaps two students in the groups array
+ *  - Number of links
  * 
  */
-void swap_students(Group* groups, int g1, int g2, int s1, int s2) {
-    Student* student_1 = groups[g1].students[s1];
-    Student* student_2 = groups[g2].students[s2];
-    groups[g1].students[s1] = student_2;
-    groups[g2].students[s2] = student_1;
+int group_attachment(Roster* roster, Groups* groups, int student, int group) {
+    int* group_of = groups->group_of;
+    int* preferences = &roster->preferences[student * MAX_STUDENT_PREFERENCES];
+    int links = 0;
+
+    for (int i=0; i<roster->preferences_size[student]; i++) {
+        if (preferences[i] != -1 && preferences[i] != student && group_of[preferences[i]] == group) {
+            links++;
+        }
+    }
+
+    for (int i=roster->listed_by_start[student]; i<roster->listed_by_start[student+1]; i++) {
+        if (roster->listed_by[i] != student && group_of[roster->listed_by[i]] == group) {
+            links++;
+        }
+    }
+
+    return links;
 }
 
 /**
- * Tries to determine if a student swap is beneficial
- * Return: float
+ * Counts how many of a student's preferences are in a group
+ * Return: int
  *
  * Inputs
- *   groups             Array of group struct
- *   number_of_groups   The number of elements in groups
- *   p                  The chance (eg 0.01) to keep bad 
- *                      swaps to escape local minima
+ *   roster     Dense students
+ *   groups     The groups
+ *   student    Dense index of the student
+ *   group      Index of the group
  * Outputs
- *  - "improved" group array
+ *  - Number of preferences in the group
  * 
  */
-float iter(Group* groups, int number_of_groups, float p) {
-    
-    /* Find two students to swap */
-    int g1; int g2; int s1; int s2;
-    compute_proposal(groups, number_of_groups, &g1, &g2, &s1, &s2);
-    
-    /* Remember the old scores in case we need to undo the swap */
-    float old_g1_h = groups[g1].happiness;
-    float old_g2_h = groups[g2].happiness;
-
-    /* Swap them */
-    swap_students(groups, g1, g2, s1, s2);
-    
-    /* Update happiness scores*/
-    float new_g1_h = set_group_happiness(&groups[g1]);
-    float new_g2_h = set_group_happiness(&groups[g2]);
+int preferences_in_group(Roster* roster, Groups* groups, int student, int group) {
+    int* preferences = &roster->preferences[student * MAX_STUDENT_PREFERENCES];
+    int count = 0;
 
-    /* Check if it wasn't beneficial */
-    float delta = (new_g1_h - old_g1_h) + (new_g2_h - old_g2_h);
-    double random_p = (double)rand() / (double)RAND_MAX;
-    if (delta < 0 && p < random_p) {
+    for (int i=0; i<roster->preferences_size[student]; i++) {
+        if (preferences[i] != -1 && groups->group_of[preferences[i]] == group) {
+            count++;
+        }
+    }
+    return count;
+}
 
-        /* Swap students back to their original positions */
-        swap_students(groups, g1, g2, s1, s2);
+/**
+ * Finds the other group holding the most of a student's preferences, the
+ * group that would make them happiest. Only the groups of their preferences
+ * can hold any, so this takes a handful of group_of lookups whatever the
+ * number of groups
+ * Return: int, group index, -1 if every known preference is in their own group
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups
+ *   student    Dense index of the student
+ *   offset     Preference to start looking from, decides between equally good groups
+ * Outputs
+ *  - Happiest group
+ * 
+ */
+int happiest_group(Roster* roster, Groups* groups, int student, int offset) {
+    int* preferences = &roster->preferences[student * MAX_STUDENT_PREFERENCES];
+    int preferences_size = roster->preferences_size[student];
+    int own_group = groups->group_of[student];
 
-        /* Undo happiness scores*/
-        groups[g1].happiness = old_g1_h;
-        groups[g2].happiness = old_g2_h;
+    int best_group = -1;
+    int best_count = 0;
+    for (int i=0; i<preferences_size; i++) {
+        int preference = preferences[(offset + i) % preferences_size];
+        if (preference == -1 || groups->group_of[preference] == own_group) {
+            continue;
+        }
 
-        return 0;
+        int group = groups->group_of[preference];
+        int count = preferences_in_group(roster, groups, student, group);
+        if (count > best_count) {
+            best_group = group;
+            best_count = count;
+        }
     }
-
-    return delta;
-
+    return best_group;
 }
 
 /**
- * Finds the worst group and prints them to stdout,
- * mainly for debugging
- * Return: void
+ * Finds a swap aimed at an unmet preference: a student is moved into the
+ * group of someone they prefer, in exchange for that group's least attached
+ * member
+ * Return: int, 1 if a proposal was found, 0 if the random students had no unmet preferences
  *
  * Inputs
- *   groups             Array of group struct
- *   number_of_groups   The number of elements in groups
+ *   roster             Dense students
+ *   groups             The groups
+ *   g1                 The first group index
+ *   g2                 The second group index
+ *   s1                 The index of the student in g1
+ *   s2                 The index of the student in g2 
+ *   rng                The chain's random stream
  * Outputs
- *  - Worst group output in stdout
+ *  - Finds two students that can be swapped
  * 
  */
-void print_worst_group(Group* groups, int number_of_groups) {
-    float worst_score = groups[0].happiness;
-    int worst_index = 0;
+int compute_directed_proposal(Roster* roster, Groups* groups, int* g1, int* g2, int* s1, int* s2, Rng* rng) {
+    int* group_of = groups->group_of;
 
-    for (int i=0; i< number_of_groups; i++) {
-        if (groups[i].happiness < worst_score) {
-            worst_score = groups[i].happiness;
-            worst_index = i;
+    for (int tries=0; tries<DIRECTED_TRIES; tries++) {
+        int student = (int) rng_below(rng, roster->num_students);
+        int preferences_size = roster->preferences_size[student];
+        if (preferences_size == 0) {
+            continue;
+        }
+
+        /* Look for an unmet preference, starting from a random one */
+        int* preferences = &roster->preferences[student * MAX_STUDENT_PREFERENCES];
+        int offset = (int) rng_below(rng, preferences_size);
+        int target = -1;
+        for (int i=0; i<preferences_size; i++) {
+            int preference = preferences[(offset + i) % preferences_size];
+            if (preference != -1 && group_of[preference] != group_of[student]) {
+                target = preference;
+                break;
+            }
+        }
+        if (target == -1) {
+            continue;
+        }
+
+        *g1 = group_of[student];
+        *g2 = group_of[target];
+
+        /* The student makes room for themselves by pushing out whoever is least attached */
+        int* members = &groups->members[*g2 * groups->max_group_size];
+        int least_links = -1;
+        for (int i=0; i<groups->group_size[*g2]; i++) {
+            if (members[i] == target) {
+                continue;
+            }
+
+            int links = group_attachment(roster, groups, members[i], *g2);
+            if (least_links == -1 || links < least_links) {
+                least_links = links;
+                *s2 = i;
+            }
         }
+        if (least_links == -1) {
+            continue;
+        }
+
+        members = &groups->members[*g1 * groups->max_group_size];
+        for (int i=0; i<groups->group_size[*g1]; i++) {
+            if (members[i] == student) {
+                *s1 = i;
+            }
+        }
+
+        return 1;
     }
 
-    printf("[DEBUG] Group %d had the worst score of: %lf\n", worst_index, worst_score);
+    return 0;
 }
 
 /**
- * Tries to move students around and maximize happiness
- * Return: int, 0 fail, 1 success
+ * Finds how much a group's points would change if one of its members
+ * was replaced, without touching the group.
+ * Only the leaving student, the joining student and the members that list
+ * either of them can change their score, so this only looks at their
+ * preferences and at the students listing them (rather than rescoring every
+ * member against every other member)
+ * Return: int
  *
  * Inputs
- *   groups             Array of group struct
- *   number_of_groups   The number of elements in groups
+ *   roster     Dense students
+ *   groups     The groups
+ *   group      The index of the group the swap happens in
+ *   leaving    The dense index of the student leaving the group
+ *   joining    The dense index of the student taking their place
  * Outputs
- *  - Updated groups, success state
+ *  - Change in the group's points
  * 
  */
-int solve(Group* groups, int number_of_groups, int confidence, float p, int group_size) {
+int group_swap_delta(Roster* roster, Groups* groups, int group, int leaving, int joining) {
+    int* group_of = groups->group_of;
 
-    /*
-    if (number_of_groups < 2) {
-        printf("Group size too small, nothing to do...\n");
-        return 0;
+    /* The leaving student's current points */
+    int leaving_points = student_points(roster, leaving, group, group_of);
+
+    /* The joining student's points, counting them in and the leaving student out */
+    int joining_points = HAPPINESS_SCALE;
+    int joining_size = roster->preferences_size[joining];
+    if (joining_size > 0) {
+        int* preferences = &roster->preferences[joining * MAX_STUDENT_PREFERENCES];
+        int joining_satisfied = 0;
+
+        for (int i=0; i<joining_size; i++) {
+            int preference = preferences[i];
+            if (preference == joining || (preference != -1 && preference != leaving && group_of[preference] == group)) {
+                joining_satisfied++;
+            }
+        }
+        joining_points = joining_satisfied * (HAPPINESS_SCALE / joining_size);
     }
-    */
 
-    /* Compute the initial group scores */
-    float scores_sum = 0;
-    for (int i=0; i<number_of_groups; i++) {
-        scores_sum += set_group_happiness(&groups[i]);
+    /* Members that listed the leaving student lose that preference */
+    int members_delta = 0;
+    for (int i=roster->listed_by_start[leaving]; i<roster->listed_by_start[leaving+1]; i++) {
+        int member = roster->listed_by[i];
+        if (member != leaving && group_of[member] == group) {
+            members_delta -= HAPPINESS_SCALE / roster->preferences_size[member];
+        }
     }
 
-    if (DEBUG) {
-        printf("[DEBUG] Initial average group score: %lf\n", scores_sum / number_of_groups);
+    /* Members that listed the joining student gain that preference */
+    for (int i=roster->listed_by_start[joining]; i<roster->listed_by_start[joining+1]; i++) {
+        int member = roster->listed_by[i];
+        if (member != leaving && group_of[member] == group) {
+            members_delta += HAPPINESS_SCALE / roster->preferences_size[member];
+        }
     }
 
-    /* 
+    return joining_points - leaving_points + members_delta;
+}
+
+/**
+ * Swaps two students
+ * Return: void
+ *
+ * Inputs
+ *   groups     The groups
+ *   g1         The first group index
+ *   g2         The second group index
+ *   s1         The index of the student in g1
+ *   s2         The index of the student in g2 
+ * Outputs
+ *  - Swaps two students in the groups
+ * 
+ */
+void swap_students(Groups* groups, int g1, int g2, int s1, int s2) {
+    int* slot_1 = &groups->members[g1 * groups->max_group_size + s1];
+    int* slot_2 = &groups->members[g2 * groups->max_group_size + s2];
+    int student_1 = *slot_1;
+    int student_2 = *slot_2;
+    *slot_1 = student_2;
+    *slot_2 = student_1;
+    groups->group_of[student_1] = g2;
+    groups->group_of[student_2] = g1;
+}
+
+/**
+ * Finds how much a group's points would change if one of its members left
+ * Return: int
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups
+ *   group      The index of the group the student leaves
+ *   leaving    The dense index of the student leaving the group
+ * Outputs
+ *  - Change in the group's points
+ * 
+ */
+int group_remove_delta(Roster* roster, Groups* groups, int group, int leaving) {
+    int* group_of = groups->group_of;
+    if (groups->group_size[group] == 1) {
+        return -groups->points[group];
+    }
+
+    /* The leaving student's points, and the members that listed them */
+    int lost = student_points(roster, leaving, group, group_of);
+    for (int i=roster->listed_by_start[leaving]; i<roster->listed_by_start[leaving+1]; i++) {
+        int member = roster->listed_by[i];
+        if (member != leaving && group_of[member] == group) {
+            lost += HAPPINESS_SCALE / roster->preferences_size[member];
+        }
+    }
+
+    return -lost;
+}
+
+/**
+ * Finds how much a group's points would change if a student joined it
+ * Return: int
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups
+ *   group      The index of the group the student joins
+ *   joining    The dense index of the student joining the group
+ * Outputs
+ *  - Change in the group's points
+ * 
+ */
+int group_insert_delta(Roster* roster, Groups* groups, int group, int joining) {
+    int* group_of = groups->group_of;
+
+    /* The joining student's points, counting them in */
+    int gained = HAPPINESS_SCALE;
+    int joining_size = roster->preferences_size[joining];
+    if (joining_size > 0) {
+        int* preferences = &roster->preferences[joining * MAX_STUDENT_PREFERENCES];
+        int joining_satisfied = 0;
+
+        for (int i=0; i<joining_size; i++) {
+            int preference = preferences[i];
+            if (preference == joining || (preference != -1 && group_of[preference] == group)) {
+                joining_satisfied++;
+            }
+        }
+        gained = joining_satisfied * (HAPPINESS_SCALE / joining_size);
+    }
+
+    /* Members that listed the joining student gain that preference */
+    for (int i=roster->listed_by_start[joining]; i<roster->listed_by_start[joining+1]; i++) {
+        int member = roster->listed_by[i];
+        if (member != joining && group_of[member] == group) {
+            gained += HAPPINESS_SCALE / roster->preferences_size[member];
+        }
+    }
+
+    return gained;
+}
+
+/**
+ * Moves a student into another group, the last member of their old group
+ * fills the gap they leave
+ * Return: void
+ *
+ * Inputs
+ *   groups     The groups
+ *   from       The group the student leaves
+ *   slot       The index of the student in from
+ *   to         The group the student joins, must have room
+ * Outputs
+ *  - Moved student
+ * 
+ */
+void relocate_student(Groups* groups, int from, int slot, int to) {
+    int* from_members = &groups->members[from * groups->max_group_size];
+    int student = from_members[slot];
+
+    groups->group_size[from]--;
+    from_members[slot] = from_members[groups->group_size[from]];
+
+    groups->members[to * groups->max_group_size + groups->group_size[to]] = student;
+    groups->group_size[to]++;
+    groups->group_of[student] = to;
+}
+
+/**
+ * Rotates three students around three groups, the first student moves into
+ * the second group, the second into the third and the third into the first
+ * Return: void
+ *
+ * Inputs
+ *   groups     The groups
+ *   g          The three group indices
+ *   s          The index of each student in their group
+ * Outputs
+ *  - Rotated students
+ * 
+ */
+void rotate_students(Groups* groups, int g[3], int s[3]) {
+    int* slots[3];
+    int students[3];
+    for (int i=0; i<3; i++) {
+        slots[i] = &groups->members[g[i] * groups->max_group_size + s[i]];
+        students[i] = *slots[i];
+    }
+
+    for (int i=0; i<3; i++) {
+        int next = (i + 1) % 3;
+        *slots[next] = students[i];
+        groups->group_of[students[i]] = g[next];
+    }
+}
+
+/**
+ * Keeps a group in or out of the chain's list of groups with room
+ * Return: void
+ *
+ * Inputs
+ *   chain      The chain
+ *   group      The group whose size changed
+ * Outputs
+ *  - Updated open_groups
+ * 
+ */
+void update_open_group(Chain* chain, int group) {
+    int is_open = chain->groups->group_size[group] < chain->groups->max_group_size;
+
+    if (is_open && chain->open_index[group] == -1) {
+        chain->open_index[group] = chain->open_count;
+        chain->open_groups[chain->open_count] = group;
+        chain->open_count++;
+
+    } else if (!is_open && chain->open_index[group] != -1) {
+        /* Fill the hole with the last open group */
+        int last = chain->open_groups[chain->open_count - 1];
+        chain->open_groups[chain->open_index[group]] = last;
+        chain->open_index[last] = chain->open_index[group];
+        chain->open_index[group] = -1;
+        chain->open_count--;
+    }
+}
+
+/**
+ * Rebuilds the chain's list of groups with room, after the groups were replaced
+ * Return: void
+ *
+ * Inputs
+ *   chain      The chain
+ * Outputs
+ *  - Updated open_groups
+ * 
+ */
+void rebuild_open_groups(Chain* chain) {
+    if (chain->open_groups == NULL) {
+        return;
+    }
+
+    chain->open_count = 0;
+    for (int i=0; i<chain->groups->number_of_groups; i++) {
+        chain->open_index[i] = -1;
+        update_open_group(chain, i);
+    }
+}
+
+/**
+ * Finds a student to move into a group with room. Students that prefer
+ * someone in the group are tried first, and the student always comes from
+ * a larger group so the group sizes never drift further apart
+ * Return: int, 1 if a proposal was found
+ *
+ * Inputs
+ *   chain      The chain
+ *   from       The group the student leaves
+ *   slot       The index of the student in from
+ *   to         The group with room
+ * Outputs
+ *  - Relocation proposal
+ * 
+ */
+int compute_relocation(Chain* chain, int* from, int* slot, int* to) {
+    Roster* roster = chain->roster;
+    Groups* groups = chain->groups;
+    if (chain->open_count == 0) {
+        return 0;
+    }
+
+    *to = chain->open_groups[rng_below(&chain->rng, chain->open_count)];
+    int to_size = groups->group_size[*to];
+
+    /* Someone who prefers a random member of the group */
+    if (to_size > 0) {
+        int member = groups->members[*to * groups->max_group_size + rng_below(&chain->rng, to_size)];
+        int start = roster->listed_by_start[member];
+        int listed = roster->listed_by_start[member + 1] - start;
+
+        if (listed > 0) {
+            int student = roster->listed_by[start + rng_below(&chain->rng, listed)];
+            *from = groups->group_of[student];
+
+            if (*from != *to && groups->group_size[*from] > to_size) {
+                int* members = &groups->members[*from * groups->max_group_size];
+                for (int i=0; i<groups->group_size[*from]; i++) {
+                    if (members[i] == student) {
+                        *slot = i;
+                    }
+                }
+                return 1;
+            }
+        }
+    }
+
+    /* Otherwise anyone from a larger group */
+    for (int tries=0; tries<RELOCATE_TRIES; tries++) {
+        *from = (int) rng_below(&chain->rng, groups->number_of_groups);
+        if (*from != *to && groups->group_size[*from] > to_size) {
+            *slot = (int) rng_below(&chain->rng, groups->group_size[*from]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Finds three students in three different groups to rotate
+ * Return: int, 1 if a proposal was found
+ *
+ * Inputs
+ *   groups     The groups
+ *   g          The three group indices
+ *   s          The index of each student in their group
+ *   rng        The chain's random stream
+ * Outputs
+ *  - Rotation proposal
+ * 
+ */
+int compute_rotation(Groups* groups, int g[3], int s[3], Rng* rng) {
+    int number_of_groups = groups->number_of_groups;
+    if (number_of_groups < 3) {
+        return 0;
+    }
+
+    for (int i=0; i<3; i++) {
+        g[i] = (int) rng_below(rng, number_of_groups);
+        if (groups->group_size[g[i]] == 0) {
+            return 0;
+        }
+        s[i] = (int) rng_below(rng, groups->group_size[g[i]]);
+    }
+
+    return g[0] != g[1] && g[1] != g[2] && g[0] != g[2];
+}
+
+/**
+ * Decides whether to keep a swap that changes the score by delta
+ * Return: int, 1 keep, 0 undo
+ *
+ * Inputs
+ *   chain      The chain the swap was proposed in
+ *   delta      The change in score the swap would make, see group_score()
+ * Outputs
+ *  - Whether to accept the swap
+ * 
+ */
+int accept_swap(Chain* chain, long long delta) {
+    if (chain->schedule == SCHEDULE_FIXED) {
+        /* Bad swaps are kept with a constant probability */
+        double random_p = rng_double(&chain->rng);
+        return !(delta < 0 && chain->p < random_p);
+    }
+
+    if (delta >= 0) {
+        return 1;
+    }
+
+    /* Metropolis rule, the worse the swap and the colder it is, the less likely it is kept */
+    if (chain->temperature <= 0) {
+        return 0;
+    }
+    double change = delta / ((double) HAPPINESS_SCALE * chain->weight);
+    return rng_double(&chain->rng) < exp(change / chain->temperature);
+}
+
+/**
+ * Checks if a student can join a group without ending up with someone they
+ * must be apart from
+ * Return: int, 1 if they can join
+ *
+ * Inputs
+ *   roster     Constrained dense students
+ *   groups     The groups
+ *   student    Dense index of the student joining
+ *   group      The group they join
+ *   leaving    Dense index of the student leaving the group at the same time, -1 if none
+ * Outputs
+ *  - Whether the student can join
+ * 
+ */
+int can_join(Roster* roster, Groups* groups, int student, int group, int leaving) {
+    for (int i=roster->apart_start[student]; i<roster->apart_start[student + 1]; i++) {
+        int other = roster->apart[i];
+        if (other != leaving && groups->group_of[other] == group) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Checks if a student can be moved on their own into a group. Students in a
+ * must-be-together set only move with their whole set, see plan_set_exchange()
+ * Return: int, 1 if the move keeps every constraint
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups
+ *   student    Dense index of the student moving
+ *   group      The group they move to
+ *   leaving    Dense index of the student leaving the group at the same time, -1 if none
+ * Outputs
+ *  - Whether the move is allowed
+ * 
+ */
+int move_allowed(Roster* roster, Groups* groups, int student, int group, int leaving) {
+    if (roster->together == NULL) {
+        return 1;
+    }
+    return !roster->pinned[student] && can_join(roster, groups, student, group, leaving);
+}
+
+/**
+ * Finds the slots of a student and the rest of their must-be-together set,
+ * sets are never split so they are all in the student's group
+ * Return: int, the number of slots
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups
+ *   group      The student's group
+ *   slot       The student's slot in the group
+ *   slots      Filled with the slots of the set
+ * Outputs
+ *  - Slots of the set
+ * 
+ */
+int set_slots(Roster* roster, Groups* groups, int group, int slot, int* slots) {
+    int* members = &groups->members[group * groups->max_group_size];
+    int student = members[slot];
+    if (!roster->pinned[student]) {
+        slots[0] = slot;
+        return 1;
+    }
+
+    int count = 0;
+    for (int i=0; i<groups->group_size[group]; i++) {
+        if (roster->together[members[i]] == roster->together[student]) {
+            slots[count] = i;
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Makes up one side of an exchange to a given number of slots with
+ * students of its group that aren't in a must-be-together set
+ * Return: int, 1 if there were enough, 0 otherwise
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups
+ *   group      The group
+ *   slots      The slots picked so far, added to
+ *   count      Number of slots picked so far
+ *   need       Number of slots wanted
+ *   offset     Slot to start looking from, wrapping around
+ * Outputs
+ *  - Padded slots
+ * 
+ */
+int pad_slots(Roster* roster, Groups* groups, int group, int* slots, int count, int need, int offset) {
+    int size = groups->group_size[group];
+    for (int k=0; k<size && count<need; k++) {
+        int slot = (offset + k) % size;
+        if (roster->pinned[groups->members[group * groups->max_group_size + slot]]) {
+            continue;
+        }
+
+        int picked = 0;
+        for (int i=0; i<count; i++) {
+            picked |= slots[i] == slot;
+        }
+        if (!picked) {
+            slots[count] = slot;
+            count++;
+        }
+    }
+    return count == need;
+}
+
+/**
+ * Checks that students joining a group aren't apart from anyone staying in it
+ * Return: int, 1 if every student can join
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups
+ *   from       The group the students leave
+ *   from_slots Their slots
+ *   to         The group they join
+ *   to_slots   Slots of the students leaving that group at the same time
+ *   count      Number of students each way
+ * Outputs
+ *  - Whether the students can join
+ * 
+ */
+int set_can_join(Roster* roster, Groups* groups, int from, int* from_slots, int to, int* to_slots, int count) {
+    int max_group_size = groups->max_group_size;
+    for (int i=0; i<count; i++) {
+        int student = groups->members[from * max_group_size + from_slots[i]];
+
+        for (int j=roster->apart_start[student]; j<roster->apart_start[student + 1]; j++) {
+            int other = roster->apart[j];
+            if (groups->group_of[other] != to) {
+                continue;
+            }
+
+            int leaving = 0;
+            for (int k=0; k<count; k++) {
+                leaving |= groups->members[to * max_group_size + to_slots[k]] == other;
+            }
+            if (!leaving) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * Plans an exchange of equal numbers of students between two groups that
+ * keeps every constraint. Each proposed student brings their whole
+ * must-be-together set, and the smaller side is made up with students of
+ * its group that aren't in a set
+ * Return: int, the number of slots exchanged each way, 0 if there is no such exchange
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups
+ *   g1         The first group
+ *   g2         The second group
+ *   s1         Slot of the proposed student in g1
+ *   s2         Slot of the proposed student in g2
+ *   slots_1    Filled with the slots of g1 to exchange, max_group_size long
+ *   slots_2    Filled with the matching slots of g2, max_group_size long
+ *   rng        Random stream to pick the made up students with, NULL to take the first ones
+ * Outputs
+ *  - Planned exchange
+ * 
+ */
+int plan_set_exchange(Roster* roster, Groups* groups, int g1, int g2, int s1, int s2, int* slots_1, int* slots_2, Rng* rng) {
+    int count_1 = set_slots(roster, groups, g1, s1, slots_1);
+    int count_2 = set_slots(roster, groups, g2, s2, slots_2);
+
+    /* A set can be made up to, but not cut down */
+    if (count_1 < count_2) {
+        int offset = (rng != NULL) ? (int) rng_below(rng, groups->group_size[g1]) : 0;
+        if (roster->pinned[groups->members[g1 * groups->max_group_size + s1]]
+            || !pad_slots(roster, groups, g1, slots_1, count_1, count_2, offset)) {
+            return 0;
+        }
+    } else if (count_2 < count_1) {
+        int offset = (rng != NULL) ? (int) rng_below(rng, groups->group_size[g2]) : 0;
+        if (roster->pinned[groups->members[g2 * groups->max_group_size + s2]]
+            || !pad_slots(roster, groups, g2, slots_2, count_2, count_1, offset)) {
+            return 0;
+        }
+    }
+
+    int count = (count_1 > count_2) ? count_1 : count_2;
+    if (!set_can_join(roster, groups, g1, slots_1, g2, slots_2, count) || !set_can_join(roster, groups, g2, slots_2, g1, slots_1, count)) {
+        return 0;
+    }
+    return count;
+}
+
+/**
+ * Exchanges students between two groups slot by slot, doing it again undoes it
+ * Return: void
+ *
+ * Inputs
+ *   groups     The groups
+ *   g1         The first group
+ *   g2         The second group
+ *   slots_1    Slots of g1 to exchange
+ *   slots_2    Matching slots of g2
+ *   count      Number of slots
+ * Outputs
+ *  - Exchanged students, points are left alone
+ * 
+ */
+void exchange_slots(Groups* groups, int g1, int g2, int* slots_1, int* slots_2, int count) {
+    for (int i=0; i<count; i++) {
+        swap_students(groups, g1, g2, slots_1[i], slots_2[i]);
+    }
+}
+
+/**
+ * Tries to determine if exchanging a must-be-together set with students of
+ * another group is beneficial, the groups are scored again as a whole
+ * Return: int, 1 if the exchange was kept, 0 otherwise
+ *
+ * Inputs
+ *   chain      The chain to make the exchange in
+ *   g1         The first group
+ *   g2         The second group
+ *   s1         Slot of the proposed student in g1
+ *   s2         Slot of the proposed student in g2
+ * Outputs
+ *  - "improved" group array and updated chain score
+ * 
+ */
+int iter_set_swap(Chain* chain, int g1, int g2, int s1, int s2) {
+    Groups* groups = chain->groups;
+    int* slots_1 = chain->set_slots;
+    int* slots_2 = chain->set_slots + groups->max_group_size;
+
+    int count = plan_set_exchange(chain->roster, groups, g1, g2, s1, s2, slots_1, slots_2, &chain->rng);
+    if (count == 0) {
+        return 0;
+    }
+
+    exchange_slots(groups, g1, g2, slots_1, slots_2, count);
+    int points_g1 = group_points_kernel(chain->roster, groups, g1);
+    int points_g2 = group_points_kernel(chain->roster, groups, g2);
+
+    long long delta = group_score_delta(groups, g1, points_g1 - groups->points[g1], 0, chain->weight)
+        + group_score_delta(groups, g2, points_g2 - groups->points[g2], 0, chain->weight);
+    if (!accept_swap(chain, delta)) {
+        exchange_slots(groups, g1, g2, slots_1, slots_2, count);
+        return 0;
+    }
+
+    set_group_points(groups, g1, points_g1);
+    set_group_points(groups, g2, points_g2);
+    chain->score += delta;
+
+    return 1;
+}
+
+/**
+ * Tries to determine if a student swap is beneficial, students in a
+ * must-be-together set are swapped with their whole set
+ * Return: int, 1 if the swap was kept, 0 otherwise
+ *
+ * Inputs
+ *   chain      The chain to propose and maybe make a swap in
+ * Outputs
+ *  - "improved" group array and updated chain score
+ * 
+ */
+int iter_swap(Chain* chain) {
+    Groups* groups = chain->groups;
+    
+    /* Find two students to swap, either aimed at an unmet preference or at random */
+    int g1; int g2; int s1; int s2;
+    int directed = chain->directed > 0 && rng_double(&chain->rng) < chain->directed;
+    if (!directed || !compute_directed_proposal(chain->roster, groups, &g1, &g2, &s1, &s2, &chain->rng)) {
+        compute_proposal(groups, &g1, &g2, &s1, &s2, &chain->rng);
+    }
+    int student_1 = groups->members[g1 * groups->max_group_size + s1];
+    int student_2 = groups->members[g2 * groups->max_group_size + s2];
+
+    if (chain->set_slots != NULL && (chain->roster->pinned[student_1] || chain->roster->pinned[student_2])) {
+        return iter_set_swap(chain, g1, g2, s1, s2);
+    }
+
+    if (!move_allowed(chain->roster, groups, student_1, g2, student_2) || !move_allowed(chain->roster, groups, student_2, g1, student_1)) {
+        return 0;
+    }
+    
+    /* Score the swap before making it */
+    int points_g1 = group_swap_delta(chain->roster, groups, g1, student_1, student_2);
+    int points_g2 = group_swap_delta(chain->roster, groups, g2, student_2, student_1);
+
+    /* Check if it wasn't beneficial */
+    long long delta = group_score_delta(groups, g1, points_g1, 0, chain->weight)
+        + group_score_delta(groups, g2, points_g2, 0, chain->weight);
+    if (!accept_swap(chain, delta)) {
+        return 0;
+    }
+
+    /* Keep the swap and update happiness scores */
+    swap_students(groups, g1, g2, s1, s2);
+    set_group_points(groups, g1, groups->points[g1] + points_g1);
+    set_group_points(groups, g2, groups->points[g2] + points_g2);
+    chain->score += delta;
+
+    return 1;
+
+}
+
+/**
+ * Tries to determine if moving a student into a group with room is beneficial
+ * Return: int, 1 if the move was kept, 0 if not, -1 if there was nothing to move
+ *
+ * Inputs
+ *   chain      The chain to propose and maybe make a move in
+ * Outputs
+ *  - "improved" group array and updated chain score
+ * 
+ */
+int iter_relocate(Chain* chain) {
+    Groups* groups = chain->groups;
+
+    int from; int slot; int to;
+    if (!compute_relocation(chain, &from, &slot, &to)) {
+        return -1;
+    }
+    int student = groups->members[from * groups->max_group_size + slot];
+
+    if (!move_allowed(chain->roster, groups, student, to, -1)) {
+        return 0;
+    }
+
+    int points_from = group_remove_delta(chain->roster, groups, from, student);
+    int points_to = group_insert_delta(chain->roster, groups, to, student);
+
+    long long delta = group_score_delta(groups, from, points_from, -1, chain->weight)
+        + group_score_delta(groups, to, points_to, 1, chain->weight);
+    if (!accept_swap(chain, delta)) {
+        return 0;
+    }
+
+    relocate_student(groups, from, slot, to);
+    set_group_points(groups, from, groups->points[from] + points_from);
+    set_group_points(groups, to, groups->points[to] + points_to);
+    chain->score += delta;
+
+    update_open_group(chain, from);
+    update_open_group(chain, to);
+
+    return 1;
+}
+
+/**
+ * Tries to determine if rotating three students around three groups is beneficial
+ * Return: int, 1 if the rotation was kept, 0 if not, -1 if no rotation was found
+ *
+ * Inputs
+ *   chain      The chain to propose and maybe make a rotation in
+ * Outputs
+ *  - "improved" group array and updated chain score
+ * 
+ */
+int iter_rotate(Chain* chain) {
+    Groups* groups = chain->groups;
+
+    int g[3]; int s[3];
+    int directed = chain->directed > 0 && rng_double(&chain->rng) < chain->directed;
+    if (directed && groups->number_of_groups >= 3 && compute_directed_proposal(chain->roster, groups, &g[0], &g[1], &s[0], &s[1], &chain->rng)) {
+        /* The member pushed out of the preferred group goes on to the group they'd be happiest in, or a random one */
+        int pushed = groups->members[g[1] * groups->max_group_size + s[1]];
+        int preferences_size = chain->roster->preferences_size[pushed];
+        g[2] = (preferences_size > 0) ? happiest_group(chain->roster, groups, pushed, (int) rng_below(&chain->rng, preferences_size)) : -1;
+        if (g[2] == -1 || g[2] == g[0]) {
+            g[2] = (int) rng_below(&chain->rng, groups->number_of_groups);
+        }
+        if (g[2] == g[0] || g[2] == g[1] || groups->group_size[g[2]] == 0) {
+            return -1;
+        }
+        s[2] = (int) rng_below(&chain->rng, groups->group_size[g[2]]);
+
+    } else if (!compute_rotation(groups, g, s, &chain->rng)) {
+        return -1;
+    }
+
+    int students[3];
+    for (int i=0; i<3; i++) {
+        students[i] = groups->members[g[i] * groups->max_group_size + s[i]];
+    }
+    for (int i=0; i<3; i++) {
+        if (!move_allowed(chain->roster, groups, students[i], g[(i + 1) % 3], students[(i + 1) % 3])) {
+            return 0;
+        }
+    }
+
+    /* Each group loses its own student and gains the one from the group before it */
+    int points[3];
+    long long delta = 0;
+    for (int i=0; i<3; i++) {
+        int previous = (i + 2) % 3;
+        points[i] = group_swap_delta(chain->roster, groups, g[i], students[i], students[previous]);
+        delta += group_score_delta(groups, g[i], points[i], 0, chain->weight);
+    }
+
+    if (!accept_swap(chain, delta)) {
+        return 0;
+    }
+
+    rotate_students(groups, g, s);
+    for (int i=0; i<3; i++) {
+        set_group_points(groups, g[i], groups->points[g[i]] + points[i]);
+    }
+    chain->score += delta;
+
+    return 1;
+}
+
+/**
+ * Picks a few groups linked to each other through preferences, starting
+ * from a random group
+ * Return: int, the number of groups picked
+ *
+ * Inputs
+ *   chain      The chain
+ *   chosen     Filled with up to LNS_GROUPS group indices
+ * Outputs
+ *  - Linked groups
+ * 
+ */
+int choose_linked_groups(Chain* chain, int chosen[LNS_GROUPS]) {
+    Roster* roster = chain->roster;
+    Groups* groups = chain->groups;
+
+    int count = 1;
+    chosen[0] = (int) rng_below(&chain->rng, groups->number_of_groups);
+
+    /* Follow a random link of a random member of a group already picked */
+    for (int tries=0; tries<LNS_GROUPS * 4 && count<LNS_GROUPS; tries++) {
+        int from = chosen[rng_below(&chain->rng, count)];
+        if (groups->group_size[from] == 0) {
+            continue;
+        }
+        int student = groups->members[from * groups->max_group_size + rng_below(&chain->rng, groups->group_size[from])];
+
+        int preferences_size = roster->preferences_size[student];
+        int start = roster->listed_by_start[student];
+        int links = preferences_size + roster->listed_by_start[student + 1] - start;
+        if (links == 0) {
+            continue;
+        }
+
+        int link = (int) rng_below(&chain->rng, links);
+        int other = (link < preferences_size) ? roster->preferences[student * MAX_STUDENT_PREFERENCES + link] : roster->listed_by[start + link - preferences_size];
+        if (other == -1) {
+            continue;
+        }
+
+        int group = groups->group_of[other];
+        int picked = 0;
+        for (int i=0; i<count; i++) {
+            if (chosen[i] == group) {
+                picked = 1;
+            }
+        }
+        if (!picked) {
+            chosen[count] = group;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Refills dissolved groups with their students, in a random order, each
+ * joining the group with room they have the most links to. Must-be-together
+ * sets are placed first, each as a whole
+ * Return: long long, the sum of the rebuilt groups' scores, -1 if a student
+ * had nowhere to go without breaking a constraint
+ *
+ * Inputs
+ *   chain      The chain, lns_students holds the students to place, sets by their first student, and lns_saved the old members
+ *   chosen     The dissolved groups, emptied before rebuilding
+ *   capacity   The size each group must end up with
+ *   count      The number of dissolved groups
+ *   students   The number of students to place
+ * Outputs
+ *  - Rebuilt groups with up to date happiness
+ * 
+ */
+long long rebuild_groups(Chain* chain, int* chosen, int* capacity, int count, int students) {
+    Roster* roster = chain->roster;
+    Groups* groups = chain->groups;
+    int* group_of = groups->group_of;
+
+    /* Shuffle the students so every rebuild is different */
+    for (int i=students-1; i>0; i--) {
+        int j = (int) rng_below(&chain->rng, i + 1);
+        int swap = chain->lns_students[i];
+        chain->lns_students[i] = chain->lns_students[j];
+        chain->lns_students[j] = swap;
+    }
+
+    /* Sets go first, while there is the most room for them */
+    if (roster->together != NULL) {
+        int front = 0;
+        for (int i=0; i<students; i++) {
+            if (roster->pinned[chain->lns_students[i]]) {
+                int swap = chain->lns_students[i];
+                chain->lns_students[i] = chain->lns_students[front];
+                chain->lns_students[front] = swap;
+                front++;
+            }
+        }
+    }
+
+    for (int i=0; i<count; i++) {
+        groups->group_size[chosen[i]] = 0;
+        for (int j=0; j<capacity[i]; j++) {
+            group_of[chain->lns_saved[i * groups->max_group_size + j]] = -1;
+        }
+    }
+
+    for (int i=0; i<students; i++) {
+        int student = chain->lns_students[i];
+        int links[LNS_GROUPS] = {0};
+
+        /* A set is placed with all of its members */
+        int* unit = &chain->lns_students[i];
+        int unit_size = 1;
+        if (roster->together != NULL && roster->pinned[student]) {
+            unit = chain->set_slots;
+            unit_size = 0;
+            for (int k=0; k<count; k++) {
+                for (int j=0; j<capacity[k]; j++) {
+                    int member = chain->lns_saved[k * groups->max_group_size + j];
+                    if (roster->together[member] == student) {
+                        unit[unit_size] = member;
+                        unit_size++;
+                    }
+                }
+            }
+        }
+
+        /* Count the links to each group, both ways */
+        for (int u=0; u<unit_size; u++) {
+            int start = roster->listed_by_start[unit[u]];
+            int* lists[2] = {&roster->preferences[unit[u] * MAX_STUDENT_PREFERENCES], &roster->listed_by[start]};
+            int sizes[2] = {roster->preferences_size[unit[u]], roster->listed_by_start[unit[u] + 1] - start};
+            for (int l=0; l<2; l++) {
+                for (int j=0; j<sizes[l]; j++) {
+                    if (lists[l][j] == -1 || group_of[lists[l][j]] == -1) {
+                        continue;
+                    }
+                    for (int k=0; k<count; k++) {
+                        if (group_of[lists[l][j]] == chosen[k]) {
+                            links[k]++;
+                        }
+                    }
+                }
+            }
+        }
+
+        /* Ties go to the group with the most room, so unlinked students spread out */
+        int best = -1;
+        for (int k=0; k<count; k++) {
+            int room = capacity[k] - groups->group_size[chosen[k]];
+            int allowed = room >= unit_size;
+            for (int u=0; u<unit_size && allowed && roster->together != NULL; u++) {
+                allowed = can_join(roster, groups, unit[u], chosen[k], -1);
+            }
+            if (!allowed) {
+                continue;
+            }
+            if (best == -1 || links[k] > links[best]
+                || (links[k] == links[best] && room > capacity[best] - groups->group_size[chosen[best]])) {
+                best = k;
+            }
+        }
+
+        if (best == -1) {
+            return -1;
+        }
+
+        int group = chosen[best];
+        for (int u=0; u<unit_size; u++) {
+            groups->members[group * groups->max_group_size + groups->group_size[group]] = unit[u];
+            groups->group_size[group]++;
+            group_of[unit[u]] = group;
+        }
+    }
+
+    long long score = 0;
+    for (int i=0; i<count; i++) {
+        set_group_happiness(roster, groups, chosen[i]);
+        score += group_score(groups->points[chosen[i]], capacity[i], chain->weight);
+    }
+    return score;
+}
+
+/**
+ * Puts members back into dissolved groups
+ * Return: void
+ *
+ * Inputs
+ *   groups     The groups
+ *   chosen     The dissolved groups
+ *   capacity   The size of each group
+ *   count      The number of dissolved groups
+ *   members    count * max_group_size members to put back
+ * Outputs
+ *  - Restored groups, points are left alone
+ * 
+ */
+void put_back_groups(Groups* groups, int* chosen, int* capacity, int count, int* members) {
+    int max_group_size = groups->max_group_size;
+
+    for (int i=0; i<count; i++) {
+        int group = chosen[i];
+        groups->group_size[group] = capacity[i];
+        for (int j=0; j<capacity[i]; j++) {
+            int student = members[i * max_group_size + j];
+            groups->members[group * max_group_size + j] = student;
+            groups->group_of[student] = group;
+        }
+    }
+}
+
+/**
+ * Large neighbourhood step, dissolves a few linked groups and rebuilds them
+ * a few different ways, then keeps the best rebuild if it is accepted
+ * Return: int, 1 if the rebuild was kept, 0 otherwise
+ *
+ * Inputs
+ *   chain      The chain to make the step in
+ * Outputs
+ *  - "improved" group array and updated chain score
+ * 
+ */
+int iter_lns(Chain* chain) {
+    Groups* groups = chain->groups;
+    int max_group_size = groups->max_group_size;
+
+    int chosen[LNS_GROUPS];
+    int count = choose_linked_groups(chain, chosen);
+    if (count < 2) {
+        return 0;
+    }
+
+    /* Remember the groups as they were */
+    int capacity[LNS_GROUPS];
+    int saved_points[LNS_GROUPS];
+    long long old_score = 0;
+    int students = 0;
+    for (int i=0; i<count; i++) {
+        int group = chosen[i];
+        capacity[i] = groups->group_size[group];
+        saved_points[i] = groups->points[group];
+        old_score += group_score(groups->points[group], capacity[i], chain->weight);
+
+        for (int j=0; j<capacity[i]; j++) {
+            int student = groups->members[group * max_group_size + j];
+            chain->lns_saved[i * max_group_size + j] = student;
+            /* A set is placed as a whole, by its first student */
+            if (chain->roster->together == NULL || chain->roster->together[student] == student) {
+                chain->lns_students[students] = student;
+                students++;
+            }
+        }
+    }
+
+    /* Rebuild a few times and keep the best */
+    long long best_score = -1;
+    for (int repair=0; repair<LNS_REPAIRS; repair++) {
+        long long score = rebuild_groups(chain, chosen, capacity, count, students);
+
+        if (score > best_score) {
+            best_score = score;
+            for (int i=0; i<count; i++) {
+                memcpy(&chain->lns_best[i * max_group_size], &groups->members[chosen[i] * max_group_size], sizeof(int) * capacity[i]);
+            }
+        }
+    }
+
+    long long delta = best_score - old_score;
+    if (best_score == -1 || !accept_swap(chain, delta)) {
+        put_back_groups(groups, chosen, capacity, count, chain->lns_saved);
+        for (int i=0; i<count; i++) {
+            set_group_points(groups, chosen[i], saved_points[i]);
+        }
+        return 0;
+    }
+
+    put_back_groups(groups, chosen, capacity, count, chain->lns_best);
+    for (int i=0; i<count; i++) {
+        set_group_happiness(chain->roster, groups, chosen[i]);
+    }
+    chain->score += delta;
+
+    return 1;
+}
+
+/**
+ * Copies the groups into the snapshot if they beat it
+ * Return: void
+ *
+ * Inputs
+ *   chain      The chain
+ * Outputs
+ *  - Up to date snapshot, allocated on first use
+ * 
+ */
+void take_snapshot(Chain* chain) {
+    if (chain->snapshot == NULL) {
+        chain->snapshot = copy_groups(chain->groups);
+        chain->snapshot_score = chain->score;
+
+    } else if (chain->score > chain->snapshot_score) {
+        copy_groups_into(chain->snapshot, chain->groups);
+        chain->snapshot_score = chain->score;
+    }
+}
+
+/**
+ * Zobrist key of a student being in a group, the hash of a grouping is the
+ * xor of the keys of all its students so a swap updates it with four xors
+ * Return: unsigned long long
+ *
+ * Inputs
+ *   student    Dense index of the student
+ *   group      Index of the group
+ * Outputs
+ *  - Key
+ * 
+ */
+unsigned long long zobrist_key(int student, int group) {
+    unsigned long long x = ((unsigned long long) student << 32) | (unsigned int) group;
+    return splitmix64(&x);
+}
+
+/**
+ * Zobrist hash of a whole grouping
+ * Return: unsigned long long
+ *
+ * Inputs
+ *   groups     The groups
+ * Outputs
+ *  - Hash
+ * 
+ */
+unsigned long long groups_hash(Groups* groups) {
+    unsigned long long hash = 0;
+    for (int i=0; i<groups->num_students; i++) {
+        hash ^= zobrist_key(i, groups->group_of[i]);
+    }
+    return hash;
+}
+
+/**
+ * Tabu step, samples a few swaps and makes the best one that isn't tabu
+ * even if it makes things worse. Recently moved students and swaps that
+ * lead back to a recently seen grouping are tabu, unless they beat the best
+ * score so far
+ * Return: int, 1 if a swap was made, 0 if every sampled swap was tabu
+ *
+ * Inputs
+ *   chain      The chain to make the step in
+ * Outputs
+ *  - Updated group array, chain score and tabu memory
+ * 
+ */
+int iter_tabu(Chain* chain) {
+    Roster* roster = chain->roster;
+    Groups* groups = chain->groups;
+
+    int best_g1 = -1; int best_g2 = 0; int best_s1 = 0; int best_s2 = 0;
+    int best_points_g1 = 0; int best_points_g2 = 0;
+    long long best_delta = 0;
+    unsigned long long best_hash = 0;
+
+    for (int i=0; i<TABU_CANDIDATES; i++) {
+        int g1; int g2; int s1; int s2;
+        int directed = chain->directed > 0 && rng_double(&chain->rng) < chain->directed;
+        if (!directed || !compute_directed_proposal(roster, groups, &g1, &g2, &s1, &s2, &chain->rng)) {
+            compute_proposal(groups, &g1, &g2, &s1, &s2, &chain->rng);
+        }
+        int student_1 = groups->members[g1 * groups->max_group_size + s1];
+        int student_2 = groups->members[g2 * groups->max_group_size + s2];
+
+        if (!move_allowed(roster, groups, student_1, g2, student_2) || !move_allowed(roster, groups, student_2, g1, student_1)) {
+            continue;
+        }
+
+        int points_g1 = group_swap_delta(roster, groups, g1, student_1, student_2);
+        int points_g2 = group_swap_delta(roster, groups, g2, student_2, student_1);
+        long long delta = group_score_delta(groups, g1, points_g1, 0, chain->weight)
+            + group_score_delta(groups, g2, points_g2, 0, chain->weight);
+        if (best_g1 != -1 && delta <= best_delta) {
+            continue;
+        }
+
+        unsigned long long hash = chain->tabu_hash ^ zobrist_key(student_1, g1) ^ zobrist_key(student_1, g2)
+            ^ zobrist_key(student_2, g2) ^ zobrist_key(student_2, g1);
+        int tabu = chain->tabu_until[student_1] > chain->iterations || chain->tabu_until[student_2] > chain->iterations
+            || chain->tabu_seen[hash & (TABU_HISTORY - 1)] == hash;
+        if (tabu && chain->score + delta <= chain->best_score) {
+            continue;
+        }
+
+        best_g1 = g1; best_g2 = g2; best_s1 = s1; best_s2 = s2;
+        best_points_g1 = points_g1; best_points_g2 = points_g2;
+        best_delta = delta;
+        best_hash = hash;
+    }
+
+    if (best_g1 == -1) {
+        return 0;
+    }
+
+    /* Keep the best grouping before walking away from it */
+    if (best_delta < 0 && chain->score >= chain->best_score) {
+        take_snapshot(chain);
+    }
+
+    int student_1 = groups->members[best_g1 * groups->max_group_size + best_s1];
+    int student_2 = groups->members[best_g2 * groups->max_group_size + best_s2];
+    swap_students(groups, best_g1, best_g2, best_s1, best_s2);
+    set_group_points(groups, best_g1, groups->points[best_g1] + best_points_g1);
+    set_group_points(groups, best_g2, groups->points[best_g2] + best_points_g2);
+    chain->score += best_delta;
+
+    /* Remember the move, so it isn't undone straight away */
+    long long tenure = TABU_TENURE + rng_below(&chain->rng, TABU_TENURE + 1);
+    chain->tabu_until[student_1] = chain->iterations + tenure;
+    chain->tabu_until[student_2] = chain->iterations + tenure;
+    chain->tabu_hash = best_hash;
+    chain->tabu_seen[best_hash & (TABU_HISTORY - 1)] = best_hash;
+
+    return 1;
+}
+
+/**
+ * Picks which kind of move to propose next, out of the enabled ones
+ * Return: int, MOVE_ constant
+ *
+ * Inputs
+ *   chain      The chain
+ * Outputs
+ *  - Move to try
+ * 
+ */
+int choose_move(Chain* chain) {
+    if (chain->moves == MOVE_SWAP) {
+        return MOVE_SWAP;
+    }
+
+    int swap_weight = (chain->moves & MOVE_SWAP) ? SWAP_WEIGHT : 0;
+    int relocate_weight = (chain->moves & MOVE_RELOCATE) ? RELOCATE_WEIGHT : 0;
+    int rotate_weight = (chain->moves & MOVE_ROTATE) ? ROTATE_WEIGHT : 0;
+
+    int choice = (int) rng_below(&chain->rng, swap_weight + relocate_weight + rotate_weight);
+    if (choice < swap_weight) {
+        return MOVE_SWAP;
+    } else if (choice < swap_weight + relocate_weight) {
+        return MOVE_RELOCATE;
+    }
+    return MOVE_ROTATE;
+}
+
+/**
+ * Proposes one move and keeps it if it is accepted. Swaps are made
+ * whenever the chosen kind of move can't be proposed
+ * Return: int, 1 if the move was kept, 0 otherwise
+ *
+ * Inputs
+ *   chain      The chain to propose and maybe make a move in
+ * Outputs
+ *  - "improved" group array and updated chain score
+ * 
+ */
+int iter(Chain* chain) {
+    if (chain->strategy == STRATEGY_LNS) {
+        return iter_lns(chain);
+    } else if (chain->strategy == STRATEGY_TABU) {
+        return iter_tabu(chain);
+    }
+
+    int move = choose_move(chain);
+    int kept = -1;
+
+    if (move == MOVE_RELOCATE) {
+        kept = iter_relocate(chain);
+    } else if (move == MOVE_ROTATE) {
+        kept = iter_rotate(chain);
+    }
+
+    if (kept == -1) {
+        kept = iter_swap(chain);
+    }
+    return kept;
+}
+
+/**
+ * Cools the chain's temperature along the rest of the current cycle
+ * Return: void
+ *
+ * Inputs
+ *   chain      The chain to cool
+ * Outputs
+ *  - Updated temperature
+ * 
+ */
+void cool(Chain* chain) {
+    double progress = (chain->progress - chain->cycle_start) / (1 - chain->cycle_start);
+    chain->temperature = chain->cycle_temperature * pow(FINAL_COOLING, progress);
+}
+
+/**
+ * Restarts the cooling from a lower temperature after the chain stopped
+ * improving, keeping a copy of the groups in case they were the best
+ * Return: void
+ *
+ * Inputs
+ *   chain      The chain to reheat
+ * Outputs
+ *  - Updated temperature, possibly a new snapshot
+ * 
+ */
+void reheat(Chain* chain) {
+    take_snapshot(chain);
+
+    chain->cycle_start = chain->progress;
+    chain->cycle_temperature *= REHEAT_FACTOR;
+    chain->last_improvement = chain->progress;
+
+    if (DEBUG) {
+        printf("[DEBUG] Reheated to %f at iteration %lld\n", chain->cycle_temperature, chain->iterations);
+    }
+}
+
+/**
+ * Puts the snapshot back if it beat where the chain ended up, then frees it
+ * Return: void
+ *
+ * Inputs
+ *   chain      The chain to finish
+ * Outputs
+ *  - Best groups in the chain
+ * 
+ */
+void restore_snapshot(Chain* chain) {
+    if (chain->snapshot == NULL) {
+        return;
+    }
+
+    if (chain->snapshot_score > chain->score) {
+        copy_groups_into(chain->groups, chain->snapshot);
+        chain->score = chain->snapshot_score;
+        rebuild_open_groups(chain);
+    }
+
+    free_groups(chain->snapshot);
+    chain->snapshot = NULL;
+}
+
+/**
+ * Refines the must-be-together sets of a pair of groups, which single swaps
+ * can't move. Makes the best improving set exchange, up to REFINE_STEPS times
+ * Return: long long, the gain in score
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups, points must be up to date
+ *   a          The first group index, at most REFINE_MAX_SIZE students
+ *   b          The second group index, at most REFINE_MAX_SIZE students
+ *   weight     Size weight from size_weight()
+ * Outputs
+ *  - Improved groups, updated happiness
+ * 
+ */
+long long refine_sets(Roster* roster, Groups* groups, int a, int b, long long weight) {
+    int max_group_size = groups->max_group_size;
+    int slots_a[REFINE_MAX_SIZE];
+    int slots_b[REFINE_MAX_SIZE];
+    long long gain = 0;
+
+    for (int step=0; step<REFINE_STEPS; step++) {
+        int best_i = -1; int best_j = -1;
+        long long best_delta = 0;
+
+        for (int i=0; i<groups->group_size[a]; i++) {
+            int pinned_a = roster->pinned[groups->members[a * max_group_size + i]];
+
+            for (int j=0; j<groups->group_size[b]; j++) {
+                if (!pinned_a && !roster->pinned[groups->members[b * max_group_size + j]]) {
+                    continue;
+                }
+
+                int count = plan_set_exchange(roster, groups, a, b, i, j, slots_a, slots_b, NULL);
+                if (count == 0) {
+                    continue;
+                }
+
+                /* Try it and put it back */
+                exchange_slots(groups, a, b, slots_a, slots_b, count);
+                long long delta = group_score_delta(groups, a, group_points_kernel(roster, groups, a) - groups->points[a], 0, weight)
+                    + group_score_delta(groups, b, group_points_kernel(roster, groups, b) - groups->points[b], 0, weight);
+                exchange_slots(groups, a, b, slots_a, slots_b, count);
+
+                if (delta > best_delta) {
+                    best_i = i; best_j = j;
+                    best_delta = delta;
+                }
+            }
+        }
+
+        if (best_i == -1) {
+            break;
+        }
+
+        int count = plan_set_exchange(roster, groups, a, b, best_i, best_j, slots_a, slots_b, NULL);
+        exchange_slots(groups, a, b, slots_a, slots_b, count);
+        set_group_happiness(roster, groups, a);
+        set_group_happiness(roster, groups, b);
+        gain += best_delta;
+    }
+
+    return gain;
+}
+
+/**
+ * Kernighan-Lin style refinement of a pair of groups. Repeatedly makes the
+ * best swap between the two groups out of the students not yet moved, even
+ * if it makes things worse, then keeps only the run of swaps that gained the
+ * most. This finds multi-swap exchanges that single swaps can't reach.
+ * Must-be-together sets are then exchanged as a whole, see refine_sets()
+ * Return: long long, the gain in score that was kept
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups, points must be up to date
+ *   a          The first group index, at most REFINE_MAX_SIZE students
+ *   b          The second group index, at most REFINE_MAX_SIZE students
+ *   weight     Size weight from size_weight()
+ * Outputs
+ *  - Improved groups, updated happiness
+ * 
+ */
+long long refine_pair(Roster* roster, Groups* groups, int a, int b, long long weight) {
+    int max_group_size = groups->max_group_size;
+    int size_a = groups->group_size[a];
+    int size_b = groups->group_size[b];
+
+    int steps = (size_a < size_b) ? size_a : size_b;
+    if (steps > REFINE_STEPS) {
+        steps = REFINE_STEPS;
+    }
+
+    /* Slots are locked once their student has moved */
+    int locked_a[REFINE_MAX_SIZE] = {0};
+    int locked_b[REFINE_MAX_SIZE] = {0};
+
+    int made_a[REFINE_STEPS];
+    int made_b[REFINE_STEPS];
+    int made_points_a[REFINE_STEPS];
+    int made_points_b[REFINE_STEPS];
+
+    long long gain = 0;
+    long long best_gain = 0;
+    int best_steps = 0;
+
+    for (int step=0; step<steps; step++) {
+        int best_i = -1; int best_j = -1;
+        long long best_delta = 0; int best_points_a = 0; int best_points_b = 0;
+
+        for (int i=0; i<size_a; i++) {
+            if (locked_a[i]) {
+                continue;
+            }
+            int student_a = groups->members[a * max_group_size + i];
+
+            for (int j=0; j<size_b; j++) {
+                if (locked_b[j]) {
+                    continue;
+                }
+                int student_b = groups->members[b * max_group_size + j];
+                if (!move_allowed(roster, groups, student_a, b, student_b) || !move_allowed(roster, groups, student_b, a, student_a)) {
+                    continue;
+                }
+
+                int points_a = group_swap_delta(roster, groups, a, student_a, student_b);
+                int points_b = group_swap_delta(roster, groups, b, student_b, student_a);
+                long long delta = group_score_delta(groups, a, points_a, 0, weight) + group_score_delta(groups, b, points_b, 0, weight);
+                if (best_i == -1 || delta > best_delta) {
+                    best_i = i; best_j = j;
+                    best_delta = delta;
+                    best_points_a = points_a; best_points_b = points_b;
+                }
+            }
+        }
+
+        /* Constraints can leave no swap to make */
+        if (best_i == -1) {
+            steps = step;
+            break;
+        }
+
+        /* Make the swap, the swapped students keep their slots so they stay locked */
+        swap_students(groups, a, b, best_i, best_j);
+        set_group_points(groups, a, groups->points[a] + best_points_a);
+        set_group_points(groups, b, groups->points[b] + best_points_b);
+        locked_a[best_i] = 1;
+        locked_b[best_j] = 1;
+
+        made_a[step] = best_i;
+        made_b[step] = best_j;
+        made_points_a[step] = best_points_a;
+        made_points_b[step] = best_points_b;
+
+        /* Scores are exact, so only a real gain is kept and rounding can't cause cycles */
+        gain += best_delta;
+        if (gain > best_gain) {
+            best_gain = gain;
+            best_steps = step + 1;
+        }
+    }
+
+    /* Undo the swaps after the best point, newest first */
+    for (int step=steps-1; step>=best_steps; step--) {
+        swap_students(groups, a, b, made_a[step], made_b[step]);
+        set_group_points(groups, a, groups->points[a] - made_points_a[step]);
+        set_group_points(groups, b, groups->points[b] - made_points_b[step]);
+    }
+
+    if (roster->together != NULL) {
+        best_gain += refine_sets(roster, groups, a, b, weight);
+    }
+    return best_gain;
+}
+
+/**
+ * Refines every pair of groups that share a preference, over and over
+ * until a whole pass finds nothing left to gain or the deadline passes.
+ * Groups larger than REFINE_MAX_SIZE are left alone
+ * Return: long long, the total gain in score
+ *
+ * Inputs
+ *   roster     Dense students
+ *   groups     The groups, points must be up to date
+ *   weight     Size weight from size_weight()
+ *   deadline   time_ms() to stop refining at, 0 for no deadline
+ *   timed_out  Set to 1 if it stopped at the deadline, 0 otherwise
+ * Outputs
+ *  - Improved groups, updated happiness
+ * 
+ */
+long long refine_groups(Roster* roster, Groups* groups, long long weight, double deadline, int* timed_out) {
+    int number_of_groups = groups->number_of_groups;
+    int max_group_size = groups->max_group_size;
+    *timed_out = 0;
+    if (max_group_size > REFINE_MAX_SIZE) {
+        return 0;
+    }
+
+    /* Marks which groups were already paired with the current one */
+    int* paired = (int*)malloc(sizeof(int) * number_of_groups);
+    if (paired == NULL) {
+        return 0;
+    }
+    for (int i=0; i<number_of_groups; i++) {
+        paired[i] = -1;
+    }
+
+    long long total_gain = 0;
+    long long refined = 0;
+    int passes = 0;
+    for (int pass=0; pass<REFINE_PASSES && !*timed_out; pass++) {
+        long long pass_gain = 0;
+
+        for (int a=0; a<number_of_groups && !*timed_out; a++) {
+            for (int k=0; k<groups->group_size[a]; k++) {
+                int student = groups->members[a * max_group_size + k];
+                int start = roster->listed_by_start[student];
+                int* lists[2] = {&roster->preferences[student * MAX_STUDENT_PREFERENCES], &roster->listed_by[start]};
+                int sizes[2] = {roster->preferences_size[student], roster->listed_by_start[student + 1] - start};
+
+                for (int l=0; l<2; l++) {
+                    for (int i=0; i<sizes[l]; i++) {
+                        if (lists[l][i] == -1) {
+                            continue;
+                        }
+
+                        /* Each pair is only looked at once per pass, from its lower group */
+                        int b = groups->group_of[lists[l][i]];
+                        if (b <= a || paired[b] == pass * number_of_groups + a) {
+                            continue;
+                        }
+                        paired[b] = pass * number_of_groups + a;
+
+                        pass_gain += refine_pair(roster, groups, a, b, weight);
+                        refined++;
+                        if (deadline > 0 && refined % REFINE_CHECK == 0 && time_ms() >= deadline) {
+                            *timed_out = 1;
+                        }
+                    }
+                }
+            }
+        }
+
+        total_gain += pass_gain;
+        passes++;
+        if (pass_gain == 0) {
+            break;
+        }
+    }
+
+    if (DEBUG) {
+        printf("[DEBUG] Refinement gained %lf over %d passes%s\n", total_gain / ((double) HAPPINESS_SCALE * weight * number_of_groups), passes, *timed_out ? ", out of time" : "");
+    }
+
+    free(paired);
+    return total_gain;
+}
+
+/**
+ * Opens a trace file and writes its header
+ * Return: FILE*, NULL if it couldn't be opened
+ *
+ * Inputs
+ *   filename   File to write to, JSON lines if it ends in .jsonl, CSV otherwise
+ *   json       Set to 1 for JSON lines, 0 for CSV
+ * Outputs
+ *  - Open trace file, close with fclose()
+ * 
+ */
+FILE* open_trace(char* filename, int* json) {
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    size_t length = strlen(filename);
+    *json = length >= 6 && strcmp(&filename[length - 6], ".jsonl") == 0;
+    if (!*json) {
+        fprintf(file, "elapsed_ms,iterations,iterations_per_sec,accepted,rejected,worsened,score,best_score,temperature\n");
+    }
+    return file;
+}
+
+/**
+ * Writes a sample of how the chain is doing to its trace file. Scores are
+ * average group happiness, the same as the final score
+ * Return: void
+ *
+ * Inputs
+ *   chain      The traced chain
+ * Outputs
+ *  - One more line in the trace file
+ * 
+ */
+void write_trace(Chain* chain) {
+    double now = time_ms();
+    double since = now - chain->last_trace;
+    double per_sec = (since > 0) ? (chain->iterations - chain->last_trace_iterations) * 1000.0 / since : 0;
+    double score_unit = (double) HAPPINESS_SCALE * chain->weight * chain->groups->number_of_groups;
+
+    if (chain->trace_json) {
+        fprintf(chain->trace, "{\"elapsed_ms\":%.1f,\"iterations\":%lld,\"iterations_per_sec\":%.0f,\"accepted\":%lld,\"rejected\":%lld,\"worsened\":%lld,\"score\":%.6f,\"best_score\":%.6f,\"temperature\":%g}\n",
+            now - chain->start_time, chain->iterations, per_sec, chain->accepted, chain->iterations - chain->accepted,
+            chain->worsened, chain->score / score_unit, chain->best_score / score_unit, chain->temperature);
+    } else {
+        fprintf(chain->trace, "%.1f,%lld,%.0f,%lld,%lld,%lld,%.6f,%.6f,%g\n",
+            now - chain->start_time, chain->iterations, per_sec, chain->accepted, chain->iterations - chain->accepted,
+            chain->worsened, chain->score / score_unit, chain->best_score / score_unit, chain->temperature);
+    }
+
+    chain->last_trace = now;
+    chain->last_trace_iterations = chain->iterations;
+}
+
+/**
+ * Saves everything needed to continue the chain to its checkpoint file
+ * Return: void
+ *
+ * Inputs
+ *   chain      The chain to save
+ * Outputs
+ *  - Checkpoint file
+ * 
+ */
+void write_checkpoint(Chain* chain) {
+    Checkpoint checkpoint;
+    checkpoint.fingerprint = chain->fingerprint;
+    checkpoint.iterations = chain->iterations;
+    checkpoint.accepted = chain->accepted;
+    checkpoint.elapsed = time_ms() - chain->start_time;
+    checkpoint.stalled = chain->stalled;
+    checkpoint.score = chain->score;
+    checkpoint.best_score = chain->best_score;
+    checkpoint.temperature = chain->temperature;
+    checkpoint.cycle_temperature = chain->cycle_temperature;
+    checkpoint.cycle_start = chain->cycle_start;
+    checkpoint.last_improvement = chain->last_improvement;
+    checkpoint.rng = chain->rng;
+    checkpoint.groups = chain->groups;
+    checkpoint.snapshot = chain->snapshot;
+    checkpoint.snapshot_score = chain->snapshot_score;
+    checkpoint.open_count = chain->open_count;
+    checkpoint.open_groups = chain->open_groups;
+
+    if (!save_checkpoint(&checkpoint, chain->checkpoint)) {
+        printf("Could not save checkpoint to %s\n", chain->checkpoint);
+    }
+    chain->last_checkpoint = time_ms();
+}
+
+/**
+ * Puts a chain back into the state saved in a checkpoint file
+ * Return: checkpoint pointer, NULL if it couldn't be loaded or is for other students.
+ *         The chain keeps using its open groups, free it after solving
+ *
+ * Inputs
+ *   chain      The chain to continue, its groups are overwritten
+ *   filename   The checkpoint file
+ * Outputs
+ *  - Resumed chain
+ * 
+ */
+Checkpoint* resume_chain(Chain* chain, char* filename) {
+    Checkpoint* checkpoint = load_checkpoint(filename);
+    if (checkpoint == NULL) {
+        printf("Could not load checkpoint %s\n", filename);
+        return NULL;
+    }
+
+    Groups* groups = chain->groups;
+    Groups* saved = checkpoint->groups;
+    if (checkpoint->fingerprint != chain->fingerprint || saved->number_of_groups != groups->number_of_groups
+        || saved->max_group_size != groups->max_group_size || saved->num_students != groups->num_students) {
+        printf("Checkpoint %s was made from different students or group size\n", filename);
+        free_checkpoint(checkpoint);
+        return NULL;
+    }
+
+    copy_groups_into(groups, saved);
+    chain->iterations = checkpoint->iterations;
+    chain->accepted = checkpoint->accepted;
+    chain->start_time -= checkpoint->elapsed;
+    chain->stalled = checkpoint->stalled;
+    chain->score = checkpoint->score;
+    chain->best_score = checkpoint->best_score;
+    chain->temperature = checkpoint->temperature;
+    chain->cycle_temperature = checkpoint->cycle_temperature;
+    chain->cycle_start = checkpoint->cycle_start;
+    chain->last_improvement = checkpoint->last_improvement;
+    chain->rng = checkpoint->rng;
+    chain->open_groups = checkpoint->open_groups;
+    chain->open_count = checkpoint->open_count;
+
+    /* The chain takes the snapshot over */
+    chain->snapshot = checkpoint->snapshot;
+    chain->snapshot_score = checkpoint->snapshot_score;
+    checkpoint->snapshot = NULL;
+
+    if (DEBUG) {
+        printf("[DEBUG] Resumed from %s at iteration %lld\n", filename, chain->iterations);
+    }
+    return checkpoint;
+}
+
+/**
+ * Finds the worst group and prints them to stdout,
+ * mainly for debugging
+ * Return: void
+ *
+ * Inputs
+ *   groups             The groups
+ * Outputs
+ *  - Worst group output in stdout
+ * 
+ */
+void print_worst_group(Groups* groups) {
+    float worst_score = groups->happiness[0];
+    int worst_index = 0;
+
+    for (int i=0; i< groups->number_of_groups; i++) {
+        if (groups->happiness[i] < worst_score) {
+            worst_score = groups->happiness[i];
+            worst_index = i;
+        }
+    }
+
+    printf("[DEBUG] Group %d had the worst score of: %lf\n", worst_index, worst_score);
+}
+
+/**
+ * Compares a chain against the best result so far. Better chains publish
+ * their groups, chains lagging too far behind restart from the best groups.
+ * Return: void
+ *
+ * Inputs
+ *   chain      The chain to synchronise
+ * Outputs
+ *  - Updated shared best, or updated chain
+ * 
+ */
+void sync_chain(Chain* chain) {
+    SharedBest* shared = chain->shared;
+
+    pthread_mutex_lock(&shared->lock);
+
+    if (chain->score > shared->score) {
+        copy_groups_into(shared->groups, chain->groups);
+        shared->score = chain->score;
+
+    } else if (chain->score < shared->score * (1 - RESTART_LAG)
+        || (chain->bound_score >= 0 && shared->score >= chain->bound_score)) {
+        copy_groups_into(chain->groups, shared->groups);
+        chain->score = shared->score;
+        rebuild_open_groups(chain);
+        if (chain->tabu_seen != NULL) {
+            chain->tabu_hash = groups_hash(chain->groups);
+        }
+    }
+
+    pthread_mutex_unlock(&shared->lock);
+}
+
+/**
+ * Trades groups with the other islands, see migrate_island(). A chain that
+ * takes another island's groups carries on from them like a restart
+ * Return: void
+ *
+ * Inputs
+ *   chain      The chain to migrate
+ * Outputs
+ *  - Published groups, or updated chain
+ * 
+ */
+void migrate_chain(Chain* chain) {
+    if (!migrate_island(chain->island_segment, chain->island, chain->groups, chain->score, chain->bound_score)) {
+        return;
+    }
+
+    for (int i=0; i<chain->groups->number_of_groups; i++) {
+        set_group_happiness(chain->roster, chain->groups, i);
+    }
+    chain->score = groups_score(chain->groups, chain->weight);
+    rebuild_open_groups(chain);
+    if (chain->tabu_seen != NULL) {
+        chain->tabu_hash = groups_hash(chain->groups);
+    }
+}
+
+/**
+ * Runs a chain of swaps, syncing with the other chains every SYNC_INTERVAL
+ * iterations when running on multiple threads
+ * Return: void*, always NULL (pthread entry point)
+ *
+ * Inputs
+ *   arg        Pointer to the chain to run
+ * Outputs
+ *  - Updated chain groups and score
+ * 
+ */
+void* run_chain(void* arg) {
+    Chain* chain = (Chain*)arg;
+
+    /* Only relocations need to know which groups have room, a resumed chain carries on with its saved list */
+    int* resumed_open = chain->open_groups;
+    chain->open_groups = NULL;
+    chain->open_index = NULL;
+    if (chain->moves & MOVE_RELOCATE) {
+        chain->open_groups = (int*)malloc(sizeof(int) * chain->groups->number_of_groups);
+        chain->open_index = (int*)malloc(sizeof(int) * chain->groups->number_of_groups);
+
+        if (chain->open_groups == NULL || chain->open_index == NULL) {
+            free(chain->open_groups);
+            free(chain->open_index);
+            chain->open_groups = NULL;
+            chain->open_index = NULL;
+            chain->moves &= ~MOVE_RELOCATE;
+        }
+    }
+
+    /* Scratch space for large neighbourhood steps */
+    chain->lns_students = NULL;
+    chain->lns_saved = NULL;
+    chain->lns_best = NULL;
+    if (chain->strategy == STRATEGY_LNS) {
+        int slots = LNS_GROUPS * chain->groups->max_group_size;
+        chain->lns_students = (int*)malloc(sizeof(int) * slots);
+        chain->lns_saved = (int*)malloc(sizeof(int) * slots);
+        chain->lns_best = (int*)malloc(sizeof(int) * slots);
+
+        /* Fall back to swapping */
+        if (chain->lns_students == NULL || chain->lns_saved == NULL || chain->lns_best == NULL) {
+            chain->strategy = STRATEGY_SWAP;
+        }
+    }
+
+    /* Must-be-together sets are swapped as a whole, fall back to leaving them where they are */
+    chain->set_slots = NULL;
+    if (chain->roster->together != NULL) {
+        chain->set_slots = (int*)malloc(sizeof(int) * 2 * chain->groups->max_group_size);
+        if (chain->set_slots == NULL && chain->strategy == STRATEGY_LNS) {
+            chain->strategy = STRATEGY_SWAP;
+        }
+    }
+
+    /* Tabu memory starts empty, even when resuming */
+    chain->tabu_until = NULL;
+    chain->tabu_seen = NULL;
+    if (chain->strategy == STRATEGY_TABU) {
+        chain->tabu_until = (long long*)calloc(chain->groups->num_students + 1, sizeof(long long));
+        chain->tabu_seen = (unsigned long long*)calloc(TABU_HISTORY, sizeof(unsigned long long));
+
+        if (chain->tabu_until == NULL || chain->tabu_seen == NULL) {
+            free(chain->tabu_until);
+            free(chain->tabu_seen);
+            chain->tabu_until = NULL;
+            chain->tabu_seen = NULL;
+            chain->strategy = STRATEGY_SWAP;
+        } else {
+            chain->tabu_hash = groups_hash(chain->groups);
+        }
+    }
+
+    if (chain->open_groups != NULL && resumed_open != NULL) {
+        memcpy(chain->open_groups, resumed_open, sizeof(int) * chain->open_count);
+        for (int i=0; i<chain->groups->number_of_groups; i++) {
+            chain->open_index[i] = -1;
+        }
+        for (int i=0; i<chain->open_count; i++) {
+            chain->open_index[chain->open_groups[i]] = i;
+        }
+    } else {
+        rebuild_open_groups(chain);
+    }
+
+    if (chain->trace != NULL) {
+        write_trace(chain);
+    }
+
+    while (1) {
+
+        /* Nothing can beat the bound */
+        if (chain->bound_score >= 0 && chain->score >= chain->bound_score) {
+            chain->stop_reason = STOP_OPTIMAL;
+            break;
+        }
+
+        /* The iteration budget is checked every time, the clock only every so often */
+        if (chain->num_iter >= 0 && chain->iterations >= chain->num_iter) {
+            chain->stop_reason = STOP_ITERATIONS;
+            break;
+        }
+
+        if (chain->iterations % CHECK_INTERVAL == 0) {
+            if (chain->time_limit > 0) {
+                chain->progress = (time_ms() - chain->start_time) / chain->time_limit;
+                if (chain->progress >= 1) {
+                    chain->stop_reason = STOP_TIME_LIMIT;
+                    break;
+                }
+            } else {
+                chain->progress = (double)chain->iterations / (double)chain->num_iter;
+            }
+
+            if (chain->schedule != SCHEDULE_FIXED) {
+                cool(chain);
+            }
+
+            if (chain->writes_checkpoints && time_ms() - chain->last_checkpoint >= chain->checkpoint_interval) {
+                write_checkpoint(chain);
+            }
+
+            if (chain->trace != NULL && time_ms() - chain->last_trace >= chain->trace_interval) {
+                write_trace(chain);
+            }
+        }
+
+        long long score = chain->score;
+        int accepted = iter(chain);
+        chain->iterations++;
+
+        if (accepted) {
+            chain->accepted++;
+            chain->stalled++;
+            if (chain->score < score) {
+                chain->worsened++;
+            }
+        }
+
+        /* Track progress so the adaptive schedule and the stall limit know when it is stuck */
+        if (chain->score > chain->best_score) {
+            chain->best_score = chain->score;
+            chain->last_improvement = chain->progress;
+            chain->stalled = 0;
+        } else if (chain->schedule == SCHEDULE_ADAPTIVE && chain->progress - chain->last_improvement > REHEAT_WINDOW) {
+            reheat(chain);
+        }
+
+        if (chain->stall_limit > 0 && chain->stalled >= chain->stall_limit) {
+            chain->stop_reason = STOP_STALLED;
+            break;
+        }
+
+        if (chain->shared != NULL && chain->iterations % SYNC_INTERVAL == 0) {
+            sync_chain(chain);
+        }
+
+        if (chain->migration_interval > 0 && chain->iterations % chain->migration_interval == 0) {
+            migrate_chain(chain);
+        }
+    }
+
+    /* Save where the chain ended, resuming from it just finishes the run */
+    if (chain->writes_checkpoints) {
+        write_checkpoint(chain);
+    }
+
+    if (chain->trace != NULL) {
+        write_trace(chain);
+    }
+
+    restore_snapshot(chain);
+    free(chain->lns_students);
+    free(chain->lns_saved);
+    free(chain->lns_best);
+    free(chain->set_slots);
+    chain->set_slots = NULL;
+    free(chain->tabu_until);
+    free(chain->tabu_seen);
+    chain->tabu_seen = NULL;
+    free(chain->open_groups);
+    free(chain->open_index);
+    chain->open_groups = NULL;
+    chain->open_index = NULL;
+
+    /* Publish the final result */
+    if (chain->shared != NULL) {
+        sync_chain(chain);
+    }
+
+    return NULL;
+}
+
+/**
+ * Runs several independent chains on copies of the groups, and copies the
+ * best scoring result back into groups
+ * Return: int, 0 fail, 1 success
+ *
+ * Inputs
+ *   base       Chain describing the starting groups and the parameters
+ *   threads    The number of chains to run, each uses its own stream of the base random stream
+ * Outputs
+ *  - Best groups found, written into base
+ * 
+ */
+int solve_parallel(Chain* base, int threads) {
+    Chain* chains = (Chain*)malloc(sizeof(Chain) * threads);
+    pthread_t* handles = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+    SharedBest shared;
+
+    if (chains == NULL || handles == NULL) {
+        free(chains);
+        free(handles);
+        return 0;
+    }
+
+    /* The starting groups are the best result so far */
+    pthread_mutex_init(&shared.lock, NULL);
+    shared.groups = base->groups;
+    shared.score = base->score;
+
+    /* Each chain gets its own copy of the groups and its own random stream */
+    int copied = 0;
+    for (int i=0; i<threads; i++) {
+        chains[i] = *base;
+        chains[i].shared = &shared;
+        chains[i].writes_checkpoints = base->writes_checkpoints && i == 0;
+        chains[i].trace = (i == 0) ? base->trace : NULL;
+        chains[i].groups = copy_groups(base->groups);
+        chains[i].snapshot = (base->snapshot != NULL) ? copy_groups(base->snapshot) : NULL;
+
+        /* Stream i + 1 of the base stream, the same as rng_stream(seed, i + 1) on a fresh run */
+        for (int j=0; j<=i; j++) {
+            rng_jump(&chains[i].rng);
+        }
+
+        if (chains[i].groups == NULL) {
+            free_groups(chains[i].snapshot);
+            break;
+        }
+        copied++;
+    }
+
+    /* Only start once every copy is made, running chains write their results into the base groups */
+    int started = 0;
+    while (started < copied && pthread_create(&handles[started], NULL, run_chain, &chains[started]) == 0) {
+        started++;
+    }
+    for (int i=started; i<copied; i++) {
+        free_groups(chains[i].groups);
+        free_groups(chains[i].snapshot);
+    }
+
+    /* The run counts as a whole, the first chain decides why it stopped */
+    base->iterations = 0;
+    base->accepted = 0;
+    for (int i=0; i<started; i++) {
+        pthread_join(handles[i], NULL);
+        base->iterations += chains[i].iterations;
+        base->accepted += chains[i].accepted;
+        if (i == 0) {
+            base->stop_reason = chains[i].stop_reason;
+        }
+        free_groups(chains[i].groups);
+    }
+
+    if (DEBUG) {
+        printf("[DEBUG] Ran %d solver chains\n", started);
+    }
+
+    base->score = shared.score;
+    pthread_mutex_destroy(&shared.lock);
+    free(chains);
+    free(handles);
+
+    return started > 0;
+}
+
+/**
+ * Tries to move students around and maximize happiness
+ * Return: int, 0 fail, 1 success
+ *
+ * Inputs
+ *   roster             Dense students
+ *   groups             The groups to improve
+ *   config             Solver parameters
+ *   report             Filled in with how the run went, can be NULL
+ * Outputs
+ *  - Updated groups, success state
+ * 
+ */
+int solve(Roster* roster, Groups* groups, SolverConfig* config, SolverReport* report) {
+
+    /*
+    if (number_of_groups < 2) {
+        printf("Group size too small, nothing to do...\n");
+        return 0;
+    }
+    */
+
+    if (config->strategy == STRATEGY_GENETIC && roster->together != NULL) {
+        printf("The genetic strategy can't keep constraints, use swap, lns or tabu\n");
+        return 0;
+    }
+
+    double start_time = time_ms();
+    int number_of_groups = groups->number_of_groups;
+    int group_size = groups->max_group_size;
+
+    /* Compute the initial group scores, the solver works with them as whole numbers */
+    int simd = use_points_kernel(group_size);
+    for (int i=0; i<number_of_groups; i++) {
+        set_group_happiness(roster, groups, i);
+    }
+    long long weight = size_weight(group_size);
+    long long scores_sum = groups_score(groups, weight);
+    double score_unit = (double) HAPPINESS_SCALE * weight * number_of_groups;
+
+    /* The best any grouping could do, the search stops if it gets there */
+    double bound;
+    int sizes_change = config->strategy == STRATEGY_SWAP && (config->moves & MOVE_RELOCATE);
+    long long bound_score = score_bound(roster, groups, weight, sizes_change, &bound);
+
+    if (DEBUG) {
+        printf("[DEBUG] Initial average group score: %lf\n", scores_sum / score_unit);
+        printf("[DEBUG] Upper bound: %lf\n", bound);
+        printf("[DEBUG] Seed: %llu\n", config->seed);
+        printf("[DEBUG] Vectorised scoring: %s\n", simd_name(simd_points_kernel(simd, group_size) != NULL ? simd : SIMD_NONE));
+    }
+
+    /* 
         Convert confidence to the number of iterations.
         Theres quite a bit of maths that is needed to come up with this,
         so just trust me bro.
+        A time limit replaces this guess entirely.
     */
-    int num_iter = (1.5 + confidence * confidence) * number_of_groups * group_size;
+    int confidence = config->confidence;
+    long long num_iter = (1.5 + confidence * confidence) * number_of_groups * group_size;
+    if (config->strategy == STRATEGY_LNS) {
+        /* Each step rebuilds several groups several times */
+        num_iter = num_iter / (LNS_GROUPS * LNS_REPAIRS) + 1;
+    } else if (config->strategy == STRATEGY_TABU) {
+        /* Each step looks at several swaps */
+        num_iter = num_iter / TABU_CANDIDATES + 1;
+    }
+    if (config->time_limit > 0) {
+        num_iter = -1;
+    }
+
+    /* The refinement has to fit in the time limit too */
+    int search_limit = config->time_limit;
+    if (config->refine && config->time_limit > 0) {
+        search_limit -= (int)(config->time_limit * REFINE_SHARE);
+    }
+
+    Chain chain;
+    chain.roster = roster;
+    chain.groups = groups;
+    chain.score = scores_sum;
+    chain.weight = weight;
+    chain.p = config->p;
+    chain.directed = config->directed;
+    chain.moves = config->moves;
+    chain.strategy = config->strategy;
+    chain.open_groups = NULL;
+    chain.open_index = NULL;
+    chain.open_count = 0;
+    rng_stream(&chain.rng, config->seed, 0);
+    chain.shared = NULL;
+    chain.island_segment = config->island_segment;
+    chain.island = config->island;
+    chain.migration_interval = config->island_segment != NULL ? config->migration_interval : 0;
+    chain.num_iter = num_iter;
+    chain.start_time = start_time;
+    chain.time_limit = search_limit;
+    chain.stall_limit = config->stall_limit;
+    chain.progress = 0;
+    chain.iterations = 0;
+    chain.accepted = 0;
+    chain.stalled = 0;
+    chain.stop_reason = STOP_ITERATIONS;
+    chain.schedule = config->schedule;
+    chain.temperature = config->temperature;
+    chain.cycle_temperature = config->temperature;
+    chain.cycle_start = 0;
+    chain.best_score = scores_sum;
+    chain.bound_score = bound_score;
+    chain.last_improvement = 0;
+    chain.snapshot = NULL;
+    chain.snapshot_score = 0;
+    chain.checkpoint = config->checkpoint;
+    chain.checkpoint_interval = config->checkpoint_interval;
+    chain.last_checkpoint = start_time;
+    chain.writes_checkpoints = config->checkpoint != NULL && config->strategy != STRATEGY_GENETIC;
+    chain.fingerprint = roster_fingerprint(roster, groups);
+    chain.trace = NULL;
+    chain.trace_json = 0;
+    chain.trace_interval = config->trace_interval;
+    chain.last_trace = start_time;
+    chain.last_trace_iterations = 0;
+    chain.worsened = 0;
+
+    /* Carry on from a checkpoint instead of the groups we were given */
+    Checkpoint* resumed = NULL;
+    if (config->resume != NULL) {
+        if (config->strategy == STRATEGY_GENETIC) {
+            printf("The genetic strategy can't be resumed from a checkpoint\n");
+            return 0;
+        }
+
+        resumed = resume_chain(&chain, config->resume);
+        if (resumed == NULL) {
+            return 0;
+        }
+        scores_sum = chain.score;
+        chain.last_trace_iterations = chain.iterations;
+    }
+
+    /* Sample the chains as they run, the genetic strategy has no chain to sample */
+    if (config->trace != NULL && config->strategy != STRATEGY_GENETIC) {
+        chain.trace = open_trace(config->trace, &chain.trace_json);
+        if (chain.trace == NULL) {
+            printf("Could not open trace file %s\n", config->trace);
+            free_checkpoint(resumed);
+            free_groups(chain.snapshot);
+            return 0;
+        }
+    }
+
+    /* Breed a population of groupings */
+    if (config->strategy == STRATEGY_GENETIC) {
+        SolverReport genetic_report;
+        SolverConfig genetic_config = *config;
+        genetic_config.time_limit = search_limit;
+        if (!solve_genetic(roster, groups, &genetic_config, start_time, &genetic_report)) {
+            return 0;
+        }
+
+        chain.score = groups_score(groups, weight);
+        chain.iterations = genetic_report.iterations;
+        chain.accepted = genetic_report.accepted;
+        chain.stop_reason = genetic_report.stop_reason;
 
     /* Iterate swapping students */
-    for (int i=0; i<num_iter; i++) {
-        scores_sum += iter(groups, number_of_groups, p);
+    } else if (config->threads > 1) {
+        if (!solve_parallel(&chain, config->threads)) {
+            if (chain.trace != NULL) {
+                fclose(chain.trace);
+            }
+            free_checkpoint(resumed);
+            free_groups(chain.snapshot);
+            return 0;
+        }
+    } else {
+        run_chain(&chain);
+    }
+    scores_sum = chain.score;
+
+    if (chain.trace != NULL) {
+        fclose(chain.trace);
+    }
+
+    /* Each parallel chain worked on its own copy of a resumed snapshot */
+    free_checkpoint(resumed);
+    free_groups(chain.snapshot);
+
+    /* Squeeze out what the random search left behind */
+    double refine_start = time_ms();
+    if (config->refine && chain.stop_reason != STOP_OPTIMAL) {
+        double deadline = (config->time_limit > 0) ? chain.start_time + config->time_limit : 0;
+        int timed_out;
+        scores_sum += refine_groups(roster, groups, weight, deadline, &timed_out);
+        if (timed_out) {
+            chain.stop_reason = STOP_TIME_LIMIT;
+        }
+    }
+
+    double elapsed = time_ms() - start_time;
+    if (report != NULL) {
+        report->iterations = chain.iterations;
+        report->accepted = chain.accepted;
+        report->stop_reason = chain.stop_reason;
+        report->elapsed = elapsed;
+        report->refine_elapsed = time_ms() - refine_start;
+        report->score = scores_sum / score_unit;
+        report->bound = bound;
     }
 
     if (DEBUG) {
-        printf("[DEBUG] Final score: %lf\n", scores_sum / number_of_groups);
-        print_worst_group(groups, number_of_groups);
+        printf("[DEBUG] Final score: %lf\n", scores_sum / score_unit);
+        printf("[DEBUG] Optimality gap: %lf\n", bound - scores_sum / score_unit);
+        printf("[DEBUG] Stopped after %lld iterations, %lld kept (%.0f ms): %s\n", chain.iterations, chain.accepted, elapsed, stop_reason_name(chain.stop_reason));
+        print_worst_group(groups);
     }
 
     return 1;
-}
\ No newline at end of file
+}
+
+/**
+ * Fills in the default solver parameters
+ * Return: void
+ *
+ * Inputs
+ *   config     The parameters to fill in
+ * Outputs
+ *  - Default config
+ * 
+ */
+void default_solver_config(SolverConfig* config) {
+    config->confidence = 3;
+    config->p = 0.00005;
+    config->threads = 1;
+    config->seed = (unsigned long long)time(NULL);
+    config->schedule = SCHEDULE_FIXED;
+    config->temperature = 0.05;
+    config->time_limit = 0;
+    config->stall_limit = 0;
+    config->init = INIT_SEQUENTIAL;
+    config->strategy = STRATEGY_SWAP;
+    config->directed = 0.5;
+    config->moves = MOVE_SWAP;
+    config->refine = 1;
+    config->checkpoint = NULL;
+    config->checkpoint_interval = 60000;
+    config->resume = NULL;
+    config->constraints = NULL;
+    config->trace = NULL;
+    config->trace_interval = 1000;
+    config->decompose = 0;
+    config->islands = 0;
+    config->migration_interval = 100000;
+    config->island_segment = NULL;
+    config->island = -1;
+}
+
+
+/**
+ * Converts a schedule name from the command line to its constant
+ * Return: int, SCHEDULE_ constant or -1 if unknown
+ *
+ * Inputs
+ *   name       "fixed", "geometric" or "adaptive"
+ * Outputs
+ *  - Schedule constant
+ * 
+ */
+int parse_schedule(char* name) {
+    if (strcmp(name, "fixed") == 0) {
+        return SCHEDULE_FIXED;
+    } else if (strcmp(name, "geometric") == 0) {
+        return SCHEDULE_GEOMETRIC;
+    } else if (strcmp(name, "adaptive") == 0) {
+        return SCHEDULE_ADAPTIVE;
+    }
+    return -1;
+}
+
+/**
+ * Converts a schedule constant to a readable name
+ * Return: char*
+ *
+ * Inputs
+ *   schedule   SCHEDULE_ constant
+ * Outputs
+ *  - Name of the schedule
+ * 
+ */
+char* schedule_name(int schedule) {
+    if (schedule == SCHEDULE_GEOMETRIC) {
+        return "geometric";
+    } else if (schedule == SCHEDULE_ADAPTIVE) {
+        return "adaptive";
+    }
+    return "fixed";
+}
+
+/**
+ * Converts a strategy name from the command line to its constant
+ * Return: int, STRATEGY_ constant or -1 if unknown
+ *
+ * Inputs
+ *   name       "swap", "genetic", "lns" or "tabu"
+ * Outputs
+ *  - Strategy constant
+ * 
+ */
+int parse_strategy(char* name) {
+    if (strcmp(name, "swap") == 0) {
+        return STRATEGY_SWAP;
+    } else if (strcmp(name, "genetic") == 0) {
+        return STRATEGY_GENETIC;
+    } else if (strcmp(name, "lns") == 0) {
+        return STRATEGY_LNS;
+    } else if (strcmp(name, "tabu") == 0) {
+        return STRATEGY_TABU;
+    }
+    return -1;
+}
+
+/**
+ * Converts a strategy constant to a readable name
+ * Return: char*
+ *
+ * Inputs
+ *   strategy   STRATEGY_ constant
+ * Outputs
+ *  - Name of the strategy
+ * 
+ */
+char* strategy_name(int strategy) {
+    if (strategy == STRATEGY_GENETIC) {
+        return "genetic";
+    } else if (strategy == STRATEGY_LNS) {
+        return "lns";
+    } else if (strategy == STRATEGY_TABU) {
+        return "tabu";
+    }
+    return "swap";
+}
+
+/**
+ * Converts a comma separated list of move names from the command line to flags
+ * Return: int, MOVE_ flags or -1 if a name is unknown or the list is empty
+ *
+ * Inputs
+ *   names      eg "swap,relocate,rotate"
+ * Outputs
+ *  - Move flags
+ * 
+ */
+int parse_moves(char* names) {
+    char list[MAX_USR_STR_INP_LEN];
+    strncpy(list, names, MAX_USR_STR_INP_LEN - 1);
+    list[MAX_USR_STR_INP_LEN - 1] = '\0';
+
+    int moves = 0;
+    char* name = strtok(list, ",");
+    while (name != NULL) {
+        if (strcmp(name, "swap") == 0) {
+            moves |= MOVE_SWAP;
+        } else if (strcmp(name, "relocate") == 0) {
+            moves |= MOVE_RELOCATE;
+        } else if (strcmp(name, "rotate") == 0) {
+            moves |= MOVE_ROTATE;
+        } else {
+            return -1;
+        }
+        name = strtok(NULL, ",");
+    }
+
+    if (moves == 0) {
+        return -1;
+    }
+    return moves;
+}
+
+/**
+ * Describes why the solver stopped
+ * Return: char*
+ *
+ * Inputs
+ *   stop_reason    STOP_ constant
+ * Outputs
+ *  - Readable reason
+ * 
+ */
+char* stop_reason_name(int stop_reason) {
+    if (stop_reason == STOP_TIME_LIMIT) {
+        return "time limit reached";
+    } else if (stop_reason == STOP_STALLED) {
+        return "stopped improving";
+    } else if (stop_reason == STOP_OPTIMAL) {
+        return "optimal";
+    }
+    return "iterations used up";
+}
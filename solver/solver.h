@@ -3,8 +3,20 @@
 
 #include "../global/global.h" /* standard libraries, consts, structs */
 
-int solve(Group* groups, int number_of_groups, int confidence, float p, int group_size);
-float student_happiness(Student student, Group group);
-float group_happiness(Group group);
+int solve(Roster* roster, Groups* groups, SolverConfig* config, SolverReport* report);
+void default_solver_config(SolverConfig* config);
+int parse_schedule(char* name);
+char* schedule_name(int schedule);
+char* stop_reason_name(int stop_reason);
+int parse_strategy(char* name);
+char* strategy_name(int strategy);
+int parse_moves(char* names);
+long long size_weight(int max_group_size);
+long long groups_score(Groups* groups, long long weight);
+long long score_bound(Roster* roster, Groups* groups, long long weight, int sizes_change, double* bound);
+int use_points_kernel(int max_group_size);
+float student_happiness(Roster* roster, int student, int group, int* group_of);
+float set_group_happiness(Roster* roster, Groups* groups, int group);
+void swap_students(Groups* groups, int g1, int g2, int s1, int s2);
 
 #endif
\ No newline at end of file
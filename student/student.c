@@ -8,6 +8,7 @@
 *******************************************************************************/
 
 #include "../utils/utils.h"
+#include "../rng/rng.h"     /* rng_below */
 
 /*******************************************************************************
  * Function prototypes
@@ -104,11 +105,12 @@ int sanity_check_students(Student* students, int num_students) {
  *
  * Inputs
  *  - num_students  the number of students in the list
+ *  - rng           the random stream to generate from
  * Outputs
  *  - An random array of students
  * 
  */
-Student* generate_students(int num_students) {
+Student* generate_students(int num_students, Rng* rng) {
 
     /* Initialise array */
     Student* students = (Student*)malloc(num_students * sizeof(Student));
@@ -119,7 +121,7 @@ Student* generate_students(int num_students) {
 
     /* Initialise the students with random ids and NULL preferences */
     for (int i = 0; i < num_students; i++) {
-        students[i].student_id = rand() % MAX_STUDENT_ID + MAX_STUDENT_ID;
+        students[i].student_id = rng_below(rng, MAX_STUDENT_ID) + MAX_STUDENT_ID;
         students[i].preferences_size = 0;
 
         for (int j = 0; j < MAX_STUDENT_PREFERENCES; j++) {
@@ -140,11 +142,11 @@ Student* generate_students(int num_students) {
         }
 
         /* Each student can have a random number of preferences [0, MAX_STUDENT_PREFERENCES] */
-        int random_num_student_preferences = rand() % (MAX_STUDENT_PREFERENCES + 1);
+        int random_num_student_preferences = rng_below(rng, MAX_STUDENT_PREFERENCES + 1);
 
         /* Compute valid preferences (can't be self or same) */
         while (students[i].preferences_size < random_num_student_preferences) {
-            int possible_preference = students[rand() % num_students].student_id;
+            int possible_preference = students[rng_below(rng, num_students)].student_id;
 
             /* Check if it's already in the preferences */
             if (simple_search(possible_preference, students[i].preferences, students[i].preferences_size) == -1) {
@@ -274,4 +276,420 @@ int load_students_from_csv(char * filename, Student ** new_students, int * num_s
     /* Close and return success */
     fclose(file);
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * Convert csv file to constraints array, each line is two student ids and
+ * "together" or "apart"
+ * Return: int, 0 success, 1 failed
+ *
+ * Inputs
+ * - filename           file to load from
+ * - new_constraints    address to store loaded constraints
+ * - num_constraints    pointer to number of loaded constraints
+ * Outputs
+ *  - Constraints from file
+ * 
+ */
+int load_constraints_from_csv(char * filename, Constraint ** new_constraints, int * num_constraints) {
+
+    FILE* file = fopen(filename, "r");
+
+    if (file == NULL) {
+        return 1;
+    }
+
+    char line[MAX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file) != NULL) {
+
+        char* student_a = strtok(line, ",");
+        char* student_b = strtok(NULL, ",");
+        char* type = strtok(NULL, ", \r\n");
+
+        /* Skip blank lines */
+        if (student_a == NULL || strspn(student_a, " \r\n") == strlen(student_a)) {
+            continue;
+        }
+
+        Constraint constraint;
+        if (student_b == NULL || type == NULL) {
+            fclose(file);
+            return 1;
+        } else if (strcmp(type, "together") == 0) {
+            constraint.type = CONSTRAINT_TOGETHER;
+        } else if (strcmp(type, "apart") == 0) {
+            constraint.type = CONSTRAINT_APART;
+        } else {
+            fclose(file);
+            return 1;
+        }
+        constraint.student_a = atoi(student_a);
+        constraint.student_b = atoi(student_b);
+
+        /* Resize to fit new constraint */
+        Constraint* new_ptr = (Constraint*)realloc(*new_constraints, sizeof(Constraint) * (*num_constraints + 1));
+        if (new_ptr == NULL) {
+            fclose(file);
+            return 1;
+        }
+
+        *new_constraints = new_ptr;
+        (*new_constraints)[*num_constraints] = constraint;
+        *num_constraints += 1;
+    }
+
+    fclose(file);
+    return 0;
+}
+
+/* Pairs a student id with its position in the students array */
+typedef struct {
+    int student_id;
+    int index;
+} IdIndex;
+
+/**
+ * Used by qsort to order ids, ties are broken by position so that
+ * duplicated ids always resolve to the first student with that id
+ * Return: int
+ *
+ * Inputs
+ *  - a     pointer to the first IdIndex
+ *  - b     pointer to the second IdIndex
+ * Outputs
+ *  - negative, zero or positive depending on order
+ * 
+ */
+int cmp_id_index(const void * a, const void * b) {
+    IdIndex* pair1 = (IdIndex*)a;
+    IdIndex* pair2 = (IdIndex*)b;
+
+    if (pair1->student_id != pair2->student_id) {
+        return (pair1->student_id < pair2->student_id) ? -1 : 1;
+    }
+    return pair1->index - pair2->index;
+}
+
+/**
+ * Finds the dense index of a student id
+ * Return: int
+ *
+ * Inputs
+ *  - lookup        id/index pairs sorted by cmp_id_index
+ *  - num_students  the number of pairs in lookup
+ *  - student_id    the id to find
+ * Outputs
+ *  - Dense index of the first student with that id, or -1
+ * 
+ */
+int find_dense_index(IdIndex* lookup, int num_students, int student_id) {
+    int low = 0;
+    int high = num_students;
+
+    /* Lower bound, so the first of any duplicated ids is found */
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (lookup[mid].student_id < student_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < num_students && lookup[low].student_id == student_id) {
+        return lookup[low].index;
+    }
+    return -1;
+}
+
+/**
+ * Remaps students to dense indices [0, num_students), in input order, with
+ * preferences rewritten as dense indices and a reverse "listed by" index.
+ * Preferences to unknown ids become -1 and can never be satisfied.
+ * Return: Roster pointer, NULL if allocation failed
+ *
+ * Inputs
+ *  - students      the array of students
+ *  - num_students  the number of students in the list
+ * Outputs
+ *  - Newly allocated roster, free with free_roster()
+ * 
+ */
+Roster* build_roster(Student* students, int num_students) {
+
+    Roster* roster = (Roster*)malloc(sizeof(Roster));
+    if (roster == NULL) {
+        return NULL;
+    }
+
+    roster->num_students = num_students;
+    roster->student_ids = (int*)malloc(sizeof(int) * (num_students + 1));
+    roster->preferences = (int*)malloc(sizeof(int) * (num_students * MAX_STUDENT_PREFERENCES + 1));
+    roster->preferences_size = (int*)malloc(sizeof(int) * (num_students + 1));
+    roster->listed_by_start = (int*)calloc(num_students + 1, sizeof(int));
+    roster->listed_by = (int*)malloc(sizeof(int) * (num_students * MAX_STUDENT_PREFERENCES + 1));
+    roster->together = NULL;
+    roster->pinned = NULL;
+    roster->apart_start = NULL;
+    roster->apart = NULL;
+    IdIndex* lookup = (IdIndex*)malloc(sizeof(IdIndex) * (num_students + 1));
+
+    if (roster->student_ids == NULL || roster->preferences == NULL || roster->preferences_size == NULL ||
+        roster->listed_by_start == NULL || roster->listed_by == NULL || lookup == NULL) {
+        free(lookup);
+        free_roster(roster);
+        return NULL;
+    }
+
+    /* Sort the ids once so every preference is a binary search */
+    for (int i = 0; i < num_students; i++) {
+        roster->student_ids[i] = students[i].student_id;
+        lookup[i].student_id = students[i].student_id;
+        lookup[i].index = i;
+    }
+    qsort(lookup, num_students, sizeof(IdIndex), cmp_id_index);
+
+    /* Rewrite the preferences as dense indices, counting how often each student is listed */
+    for (int i = 0; i < num_students; i++) {
+        int* preferences = &roster->preferences[i * MAX_STUDENT_PREFERENCES];
+        roster->preferences_size[i] = students[i].preferences_size;
+
+        for (int j = 0; j < MAX_STUDENT_PREFERENCES; j++) {
+            preferences[j] = -1;
+            if (j < students[i].preferences_size) {
+                preferences[j] = find_dense_index(lookup, num_students, students[i].preferences[j]);
+                if (preferences[j] != -1) {
+                    roster->listed_by_start[preferences[j] + 1]++;
+                }
+            }
+        }
+    }
+
+    /* Convert the counts to offsets, then fill in the reverse index */
+    for (int i = 0; i < num_students; i++) {
+        roster->listed_by_start[i + 1] += roster->listed_by_start[i];
+    }
+
+    IdIndex* fill = lookup; /* The lookup is no longer needed, reuse it as fill positions */
+    for (int i = 0; i < num_students; i++) {
+        fill[i].index = roster->listed_by_start[i];
+    }
+
+    for (int i = 0; i < num_students; i++) {
+        for (int j = 0; j < MAX_STUDENT_PREFERENCES; j++) {
+            int preference = roster->preferences[i * MAX_STUDENT_PREFERENCES + j];
+            if (preference != -1) {
+                roster->listed_by[fill[preference].index] = i;
+                fill[preference].index++;
+            }
+        }
+    }
+
+    free(lookup);
+
+    if (DEBUG) {
+        printf("[DEBUG] Remapped %d students to dense indices\n", num_students);
+    }
+
+    return roster;
+}
+
+/**
+ * Finds the first student of a must-be-together set, flattening the path
+ * to it on the way
+ * Return: int
+ *
+ * Inputs
+ *  - together      Parent of each student, the first student of a set is its own parent
+ *  - student       Dense index of the student
+ * Outputs
+ *  - Dense index of the first student in the set
+ * 
+ */
+int find_together(int* together, int student) {
+    while (together[student] != student) {
+        together[student] = together[together[student]];
+        student = together[student];
+    }
+    return student;
+}
+
+/**
+ * Adds hard constraints to a roster. Must-be-together pairs are merged into
+ * sets, and each student gets a list of who they must be apart from, so the
+ * solver can check a move against the groups with a few group_of lookups.
+ * Constraints naming unknown students are ignored.
+ * Return: int, 0 fail, 1 success
+ *
+ * Inputs
+ *  - roster            the roster to constrain
+ *  - constraints       constraints by student id
+ *  - num_constraints   the number of constraints
+ * Outputs
+ *  - Roster with together, pinned, apart_start and apart filled in
+ * 
+ */
+int add_constraints(Roster* roster, Constraint* constraints, int num_constraints) {
+    int num_students = roster->num_students;
+
+    roster->together = (int*)malloc(sizeof(int) * (num_students + 1));
+    roster->pinned = (int*)calloc(num_students + 1, sizeof(int));
+    roster->apart_start = (int*)calloc(num_students + 1, sizeof(int));
+    int* dense = (int*)malloc(sizeof(int) * (num_constraints * 2 + 1));
+    IdIndex* lookup = (IdIndex*)malloc(sizeof(IdIndex) * (num_students + 1));
+
+    if (roster->together == NULL || roster->pinned == NULL || roster->apart_start == NULL || dense == NULL || lookup == NULL) {
+        free(dense);
+        free(lookup);
+        return 0;
+    }
+
+    for (int i = 0; i < num_students; i++) {
+        roster->together[i] = i;
+        lookup[i].student_id = roster->student_ids[i];
+        lookup[i].index = i;
+    }
+    qsort(lookup, num_students, sizeof(IdIndex), cmp_id_index);
+
+    /* Remap to dense indices, merging together sets and counting apart pairs */
+    for (int i = 0; i < num_constraints; i++) {
+        int a = find_dense_index(lookup, num_students, constraints[i].student_a);
+        int b = find_dense_index(lookup, num_students, constraints[i].student_b);
+        dense[i * 2] = a;
+        dense[i * 2 + 1] = b;
+
+        if (a == -1 || b == -1) {
+            if (DEBUG) {
+                printf("[DEBUG] Ignored constraint between unknown students %d and %d\n", constraints[i].student_a, constraints[i].student_b);
+            }
+            continue;
+        }
+
+        if (constraints[i].type == CONSTRAINT_TOGETHER) {
+            /* The lower index becomes the first student of the merged set */
+            int root_a = find_together(roster->together, a);
+            int root_b = find_together(roster->together, b);
+            if (root_a < root_b) {
+                roster->together[root_b] = root_a;
+            } else {
+                roster->together[root_a] = root_b;
+            }
+        } else if (a == b) {
+            printf("Student %d can't be apart from themselves\n", constraints[i].student_a);
+            free(dense);
+            free(lookup);
+            return 0;
+        } else {
+            roster->apart_start[a + 1]++;
+            roster->apart_start[b + 1]++;
+        }
+    }
+    free(lookup);
+
+    /* Point every student straight at the first of their set, and pin sets of more than one */
+    for (int i = 0; i < num_students; i++) {
+        roster->together[i] = find_together(roster->together, i);
+        if (roster->together[i] != i) {
+            roster->pinned[i] = 1;
+            roster->pinned[roster->together[i]] = 1;
+        }
+    }
+
+    /* Convert the counts to offsets, then fill in both directions of every apart pair */
+    for (int i = 0; i < num_students; i++) {
+        roster->apart_start[i + 1] += roster->apart_start[i];
+    }
+
+    roster->apart = (int*)malloc(sizeof(int) * (roster->apart_start[num_students] + 1));
+    int* fill = (int*)malloc(sizeof(int) * (num_students + 1));
+    if (roster->apart == NULL || fill == NULL) {
+        free(dense);
+        free(fill);
+        return 0;
+    }
+    memcpy(fill, roster->apart_start, sizeof(int) * num_students);
+
+    for (int i = 0; i < num_constraints; i++) {
+        int a = dense[i * 2];
+        int b = dense[i * 2 + 1];
+        if (constraints[i].type != CONSTRAINT_APART || a == -1 || b == -1) {
+            continue;
+        }
+
+        if (roster->together[a] == roster->together[b]) {
+            printf("Students %d and %d must be both together and apart\n", constraints[i].student_a, constraints[i].student_b);
+            free(dense);
+            free(fill);
+            return 0;
+        }
+
+        roster->apart[fill[a]++] = b;
+        roster->apart[fill[b]++] = a;
+    }
+
+    free(dense);
+    free(fill);
+
+    if (DEBUG) {
+        printf("[DEBUG] Added %d constraints\n", num_constraints);
+    }
+
+    return 1;
+}
+
+/**
+ * Loads a constraints file and adds it to a roster
+ * Return: int, 0 fail, 1 success
+ *
+ * Inputs
+ *  - roster    the roster to constrain
+ *  - filename  constraints csv, see load_constraints_from_csv()
+ * Outputs
+ *  - Constrained roster, the reason is printed on failure
+ * 
+ */
+int constrain_roster(Roster* roster, char* filename) {
+    Constraint* constraints = (Constraint*)malloc(sizeof(Constraint) * 0);
+    int num_constraints = 0;
+
+    if (load_constraints_from_csv(filename, &constraints, &num_constraints) == 1) {
+        free(constraints);
+        printf("Invalid constraints file\n");
+        return 0;
+    }
+
+    int added = add_constraints(roster, constraints, num_constraints);
+    free(constraints);
+
+    if (!added) {
+        printf("Could not add the constraints\n");
+    }
+    return added;
+}
+
+/**
+ * Frees a roster and all of its arrays
+ * Return: void
+ *
+ * Inputs
+ *  - roster    the roster to free, can be NULL
+ * Outputs
+ *  - Deallocated memory
+ * 
+ */
+void free_roster(Roster* roster) {
+    if (roster == NULL) {
+        return;
+    }
+
+    free(roster->student_ids);
+    free(roster->preferences);
+    free(roster->preferences_size);
+    free(roster->listed_by_start);
+    free(roster->listed_by);
+    free(roster->together);
+    free(roster->pinned);
+    free(roster->apart_start);
+    free(roster->apart);
+    free(roster);
+}
@@ -3,9 +3,15 @@
 
 #include "../global/global.h" /* standard libraries, consts, structs */
 
-Student* generate_students(int num_students);
+Student* generate_students(int num_students, Rng* rng);
 void display_students(Student* students, int num_students);
 int sanity_check_students(Student* students, int num_students);
 int load_students_from_csv(char * filename, Student ** new_students, int * num_students);
+int load_constraints_from_csv(char * filename, Constraint ** new_constraints, int * num_constraints);
+Roster* build_roster(Student* students, int num_students);
+int find_together(int* together, int student);
+int add_constraints(Roster* roster, Constraint* constraints, int num_constraints);
+int constrain_roster(Roster* roster, char* filename);
+void free_roster(Roster* roster);
 
 #endif
\ No newline at end of file
@@ -9,6 +9,8 @@
 
 #include "utils.h"
 
+#include <time.h>   /* clock_gettime */
+
 /*******************************************************************************
  * Global variables
 *******************************************************************************/
@@ -80,7 +82,7 @@ int binary_search(int target, int* arr, int low, int high) {
  * 
  */
 int fast_search(int target, int* arr, int arr_size) {
-    return binary_search(target, arr, 0, arr_size);
+    return binary_search(target, arr, 0, arr_size - 1);
 }
 
 /**
@@ -167,3 +169,19 @@ void sort(int* arr, int arr_size) {
     quickSort(arr, 0, arr_size-1);
 }
 
+
+/**
+ * Milliseconds on a clock that only moves forward, for timing
+ * Return: double
+ *
+ * Inputs
+ * - nan
+ * Outputs
+ *  - Current time in milliseconds, only meaningful as a difference
+ * 
+ */
+double time_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
@@ -4,5 +4,6 @@
 int simple_search(int target, int* arr, int arr_size);
 int fast_search(int target, int* arr, int arr_size); /* Only works with sorted arrays... */
 void sort(int* arr, int arr_size);
+double time_ms(void);
 
 #endif
\ No newline at end of file